@@ -0,0 +1,67 @@
+#include "filterKernels.hpp"
+#include <algorithm>
+
+namespace w2xc {
+
+// number of output pixels accumulated at once (kept in L1 / registers)
+static constexpr int tileWidth = 64;
+
+// one 3x3 tap set at column x, with replicated borders
+static inline float convolvePixelClamped(const float *r0, const float *r1,
+		const float *r2, const float *w, int x, int width) {
+	int xl = std::max(x - 1, 0);
+	int xr = std::min(x + 1, width - 1);
+	return w[0] * r0[xl] + w[1] * r0[x] + w[2] * r0[xr]
+			+ w[3] * r1[xl] + w[4] * r1[x] + w[5] * r1[xr]
+			+ w[6] * r2[xl] + w[7] * r2[x] + w[8] * r2[xr];
+}
+
+void filterRow3x3(const float * const *inputRows, int nInputPlanes,
+		const float *weights, float bias, float *outputRow, int width) {
+
+	float acc[tileWidth];
+
+	for (int x0 = 0; x0 < width; x0 += tileWidth) {
+		int x1 = std::min(x0 + tileWidth, width);
+		// interior columns can read x-1 and x+1 without clamping
+		int xb = std::max(x0, 1);
+		int xe = std::min(x1, width - 1);
+
+		std::fill(acc, acc + (x1 - x0), 0.0f);
+
+		for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+			const float *r0 = inputRows[ipIndex * 3 + 0];
+			const float *r1 = inputRows[ipIndex * 3 + 1];
+			const float *r2 = inputRows[ipIndex * 3 + 2];
+			const float *w = weights + ipIndex * 9;
+			const float w0 = w[0], w1 = w[1], w2 = w[2];
+			const float w3 = w[3], w4 = w[4], w5 = w[5];
+			const float w6 = w[6], w7 = w[7], w8 = w[8];
+
+			for (int x = xb; x < xe; x++) {
+				acc[x - x0] += w0 * r0[x - 1] + w1 * r0[x] + w2 * r0[x + 1]
+						+ w3 * r1[x - 1] + w4 * r1[x] + w5 * r1[x + 1]
+						+ w6 * r2[x - 1] + w7 * r2[x] + w8 * r2[x + 1];
+			}
+
+			// border columns
+			if (x0 == 0) {
+				acc[0] += convolvePixelClamped(r0, r1, r2, w, 0, width);
+			}
+			if (x1 == width && width > 1) {
+				acc[width - 1 - x0] += convolvePixelClamped(r0, r1, r2, w,
+						width - 1, width);
+			}
+		} // for ipIndex
+
+		// bias and LeakyReLU(0.1)
+		for (int x = x0; x < x1; x++) {
+			float v = acc[x - x0] + bias;
+			outputRow[x] = v > 0.0f ? v : v * 0.1f;
+		}
+
+	} // for x0
+
+}
+
+}
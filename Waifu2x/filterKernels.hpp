@@ -0,0 +1,23 @@
+#ifndef FILTER_KERNELS_HPP_
+#define FILTER_KERNELS_HPP_
+
+namespace w2xc {
+
+/**
+ * compute one row of one output plane by 3x3 convolution over all input planes,
+ * and then add bias and apply LeakyReLU(0.1), in the same pass.
+ *
+ * inputRows : 3 row pointers (upper, center, lower) per input plane,
+ *             inputRows[ipIndex * 3 + 0..2]
+ * weights   : 9 coefficients (row-major 3x3) per input plane,
+ *             weights[ipIndex * 9 + 0..8]
+ *
+ * columns outside of the row are replicated (same as cv::BORDER_REPLICATE).
+ * each pixel of outputRow is written exactly once.
+ */
+void filterRow3x3(const float * const *inputRows, int nInputPlanes,
+		const float *weights, float bias, float *outputRow, int width);
+
+}
+
+#endif /* FILTER_KERNELS_HPP_ */
@@ -9,7 +9,22 @@
 #include "convertRoutine.hpp"
 #include <time.h>
 
+// plane is the same value everywhere (chroma of grayscale image)
+// (exactly, so that faint colour of an image is never dropped)
+bool isConstantPlane(const cv::Mat& plane) {
+	double minValue, maxValue;
+	cv::minMaxLoc(plane, &minValue, &maxValue);
+	return minValue == maxValue;
+}
+
 bool superres(cv::Mat input, cv::Mat& output, float scale, bool noise_reduction) {
+	// planes are kept separately until the end, so that only Y goes
+	// through the models and only U/V are resized by bicubic
+	std::vector<cv::Mat> imageSplit;
+	cv::split(input, imageSplit);
+	cv::Mat imageY = imageSplit[0];
+	bool grayImage = isConstantPlane(imageSplit[1]) && isConstantPlane(imageSplit[2]);
+
 	// noise reduction
 	if (noise_reduction) {
 		std::string modelFileName = "models/noise1_model.json";
@@ -18,14 +33,9 @@ bool superres(cv::Mat input, cv::Mat& output, float scale, bool noise_reduction)
 			return false;
 		}
 
-		std::vector<cv::Mat> imageSplit;
-		cv::Mat imageY;
-		cv::split(input, imageSplit);
-		imageSplit[0].copyTo(imageY);
-
-		w2xc::convertWithModels(imageY, imageSplit[0], models);
-
-		cv::merge(imageSplit, input);
+		cv::Mat imageDenoised;
+		w2xc::convertWithModels(imageY, imageDenoised, models);
+		imageY = imageDenoised;
 	}
 
 	// scaling
@@ -50,39 +60,46 @@ bool superres(cv::Mat input, cv::Mat& output, float scale, bool noise_reduction)
 		for (int nIteration = 0; nIteration < iterTimesTwiceScaling; nIteration++) {
 			std::cout << "#" << std::to_string(nIteration + 1) << " 2x scaling..." << std::endl;
 
-			cv::Size imageSize = input.size();
+			cv::Size imageSize = imageY.size();
 			imageSize.width *= 2;
 			imageSize.height *= 2;
-			cv::Mat image2xNearest;
-			cv::resize(input, image2xNearest, imageSize, 0, 0, cv::INTER_NEAREST);
-			std::vector<cv::Mat> imageSplit;
-			cv::Mat imageY;
-			cv::split(image2xNearest, imageSplit);
-			imageSplit[0].copyTo(imageY);
-
-			// generate bicubic scaled image and split
-			imageSplit.clear();
-			cv::Mat image2xBicubic;
-			cv::resize(input, image2xBicubic, imageSize, 0, 0, cv::INTER_CUBIC);
-			cv::split(image2xBicubic, imageSplit);
-
-			if (!w2xc::convertWithModels(imageY, imageSplit[0], models)) {
+			cv::Mat imageY2xNearest;
+			cv::resize(imageY, imageY2xNearest, imageSize, 0, 0, cv::INTER_NEAREST);
+
+			if (!w2xc::convertWithModels(imageY2xNearest, imageY, models)) {
 				std::cerr << "w2xc::convertWithModels : something error has occured.\nstop." << std::endl;
 				return false;
 			}
 
-			cv::merge(imageSplit, input);
+			// chroma is scaled by bicubic interpolation
+			if (!grayImage) {
+				cv::resize(imageSplit[1], imageSplit[1], imageSize, 0, 0, cv::INTER_CUBIC);
+				cv::resize(imageSplit[2], imageSplit[2], imageSize, 0, 0, cv::INTER_CUBIC);
+			}
 
 		} // 2x scaling : end
 
 		if (shrinkRatio != 0.0) {
-			cv::Size lastImageSize = input.size();
+			cv::Size lastImageSize = imageY.size();
 			lastImageSize.width = lastImageSize.width * shrinkRatio;
 			lastImageSize.height = lastImageSize.height * shrinkRatio;
-			cv::resize(input, input, lastImageSize, 0, 0, cv::INTER_LINEAR);
+			cv::resize(imageY, imageY, lastImageSize, 0, 0, cv::INTER_LINEAR);
+			if (!grayImage) {
+				cv::resize(imageSplit[1], imageSplit[1], lastImageSize, 0, 0, cv::INTER_LINEAR);
+				cv::resize(imageSplit[2], imageSplit[2], lastImageSize, 0, 0, cv::INTER_LINEAR);
+			}
 		}
 	}
 
+	// constant chroma of grayscale image is made only for the conversion to RGB
+	// (chroma planes are still of the input size)
+	imageSplit[0] = imageY;
+	if (grayImage) {
+		imageSplit[1] = cv::Mat(imageY.size(), CV_32FC1, cv::mean(imageSplit[1]));
+		imageSplit[2] = cv::Mat(imageY.size(), CV_32FC1, cv::mean(imageSplit[2]));
+	}
+	cv::merge(imageSplit, input);
+
 	cv::cvtColor(input, output, cv::COLOR_YUV2RGB);
 	output.convertTo(output, CV_8U, 255.0);
 
@@ -1,6 +1,8 @@
 #include "modelHandler.hpp"
+#include "filterKernels.hpp"
 #include <fstream>
 #include <thread>
+#include <algorithm>
 
 namespace w2xc {
 	
@@ -63,10 +65,43 @@ bool Model::loadModelFromJSONObject(const nlohmann::json& jsonObj) {
 }
 
 bool Model::filterWorker(const std::vector<cv::Mat>& inputPlanes, const std::vector<std::vector<cv::Mat>>& weightMatrices, std::vector<cv::Mat>& outputPlanes, unsigned int beginningIndex, unsigned int nWorks) const {
-	cv::ocl::setUseOpenCL(false); // disable OpenCL Support(temporary)
-
 	cv::Size ipSize = inputPlanes[0].size();
 
+	if (kernelSize == 3) {
+		// fused 3x3 kernel : all input planes are accumulated per output tile,
+		// and bias + LeakyReLU are applied in the same pass
+		std::vector<float> opWeights(nInputPlanes * 9);
+		std::vector<const float*> inputRows(nInputPlanes * 3);
+
+		for (int opIndex = beginningIndex; opIndex < (beginningIndex + nWorks); opIndex++) {
+			outputPlanes[opIndex] = cv::Mat(ipSize, CV_32FC1);
+
+			for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+				for (int r = 0; r < 3; r++) {
+					const float* weightRow = weightMatrices[opIndex][ipIndex].ptr<float>(r);
+					std::copy(weightRow, weightRow + 3, opWeights.begin() + ipIndex * 9 + r * 3);
+				}
+			}
+
+			for (int y = 0; y < ipSize.height; y++) {
+				// rows outside of the plane are replicated
+				int yUpper = std::max(y - 1, 0);
+				int yLower = std::min(y + 1, ipSize.height - 1);
+				for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+					inputRows[ipIndex * 3 + 0] = inputPlanes[ipIndex].ptr<float>(yUpper);
+					inputRows[ipIndex * 3 + 1] = inputPlanes[ipIndex].ptr<float>(y);
+					inputRows[ipIndex * 3 + 2] = inputPlanes[ipIndex].ptr<float>(yLower);
+				}
+				filterRow3x3(inputRows.data(), nInputPlanes, opWeights.data(), biases[opIndex], outputPlanes[opIndex].ptr<float>(y), ipSize.width);
+			}
+		}
+
+		return true;
+	}
+
+	// generic path (kernel size other than 3x3)
+	cv::ocl::setUseOpenCL(false); // disable OpenCL Support(temporary)
+
 	for (int opIndex = beginningIndex; opIndex < (beginningIndex + nWorks);	opIndex++) {
 		outputPlanes[opIndex] = cv::Mat::zeros(ipSize, CV_32FC1);
 
@@ -441,7 +441,7 @@ template<typename _Tp, int n> inline v_reg<_Tp, n> v_load_aligned(const _Tp* ptr
     return v_reg<_Tp, n>(ptr);
 }
 
-template<typename _Tp, int n> inline void v_load_halves(const _Tp* loptr, const _Tp* hiptr)
+template<typename _Tp, int n> inline v_reg<_Tp, n> v_load_halves(const _Tp* loptr, const _Tp* hiptr)
 {
     v_reg<_Tp, n> c;
     for( int i = 0; i < n/2; i++ )
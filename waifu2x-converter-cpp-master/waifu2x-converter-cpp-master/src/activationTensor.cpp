@@ -0,0 +1,174 @@
+/*
+ * activationTensor.cpp
+ *   activation planes of a layer in channel-blocked (NCHWc) layout
+ */
+
+#include "activationTensor.hpp"
+#include "halfFloat.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace w2xc {
+
+ActivationTensor::ActivationTensor() :
+		precision(ActivationPrecision::Float), nChannels(0), nBlocks(0),
+		tensorSize(0, 0), rowStride(0), blockStride(0), origin(nullptr) {
+}
+
+ActivationTensor::ActivationTensor(int nChannels, cv::Size size,
+		ActivationPrecision precision) :
+		precision(precision), nChannels(nChannels), tensorSize(size) {
+
+	// elements per 64 bytes
+	const int alignElements = bufferAlignment / getElementSize();
+	// halo pixel is placed right before a 64-byte boundary,
+	// so that pixel 0 of every row is aligned
+	const int leftMargin = alignElements;
+
+	nBlocks = (nChannels + tensorChannelBlock - 1) / tensorChannelBlock;
+	int rowElements = leftMargin + (size.width + halo) * tensorChannelBlock;
+	rowStride = (rowElements + alignElements - 1) / alignElements
+			* alignElements;
+	blockStride = rowStride * (size.height + 2 * halo);
+
+	std::size_t bytes = static_cast<std::size_t>(nBlocks) * blockStride
+			* getElementSize();
+	storage = std::make_shared<AlignedBuffer<float> >(
+			(bytes + sizeof(float) - 1) / sizeof(float));
+	origin = reinterpret_cast<unsigned char *>(storage->data())
+			+ (halo * rowStride + leftMargin) * getElementSize();
+
+}
+
+ActivationTensor ActivationTensor::roi(cv::Rect rect) const {
+	ActivationTensor region(*this);
+	region.tensorSize = rect.size();
+	region.origin = origin + getOffset(0, rect.y)
+			+ rect.x * tensorChannelBlock * getElementSize();
+	return region;
+}
+
+// rows of block b are rowStride elements apart, starting at row0 (pixel 0)
+template<typename T>
+static void fillHaloOfBlock(T *row0, int rowStride, int width, int height) {
+	const int C = tensorChannelBlock;
+	const int halo = ActivationTensor::halo;
+
+	// left and right columns
+	for (int y = 0; y < height; y++) {
+		T *row = row0 + y * rowStride;
+		std::copy(row, row + C, row - halo * C);
+		std::copy(row + (width - 1) * C, row + width * C, row + width * C);
+	}
+	// upper and lower rows (including corners)
+	std::copy(row0 - halo * C, row0 + (width + halo) * C,
+			row0 - rowStride - halo * C);
+	std::copy(row0 + (height - 1) * rowStride - halo * C,
+			row0 + (height - 1) * rowStride + (width + halo) * C,
+			row0 + height * rowStride - halo * C);
+}
+
+void ActivationTensor::fillHalo() {
+	for (int b = 0; b < nBlocks; b++) {
+		if (precision == ActivationPrecision::Half) {
+			fillHaloOfBlock(halfPtr(b, 0), rowStride, tensorSize.width,
+					tensorSize.height);
+		} else {
+			fillHaloOfBlock(ptr(b, 0), rowStride, tensorSize.width,
+					tensorSize.height);
+		}
+	}
+}
+
+void ActivationTensor::convertRows(const ActivationTensor &src, int srcRow,
+		ActivationTensor &dst, int dstRow, int nRows) {
+	const int C = tensorChannelBlock;
+	const int rowElements = (src.tensorSize.width + 2 * halo) * C;
+
+	for (int b = 0; b < src.nBlocks; b++) {
+		for (int y = 0; y < nRows; y++) {
+			if (src.precision == dst.precision) {
+				std::memcpy(dst.origin + dst.getOffset(b, dstRow + y)
+						- halo * C * dst.getElementSize(),
+						src.origin + src.getOffset(b, srcRow + y)
+								- halo * C * src.getElementSize(),
+						rowElements * src.getElementSize());
+			} else if (src.precision == ActivationPrecision::Half) {
+				convertHalfToFloat(src.halfPtr(b, srcRow + y) - halo * C,
+						dst.ptr(b, dstRow + y) - halo * C, rowElements);
+			} else {
+				convertFloatToHalf(src.ptr(b, srcRow + y) - halo * C,
+						dst.halfPtr(b, dstRow + y) - halo * C, rowElements);
+			}
+		}
+	}
+}
+
+ActivationTensor ActivationTensor::fromPlanes(
+		const std::vector<cv::Mat> &planes, ActivationPrecision precision) {
+	ActivationTensor tensor(static_cast<int>(planes.size()), planes[0].size(),
+			precision);
+	const int C = tensorChannelBlock;
+	const int width = tensor.tensorSize.width;
+	std::vector<uint16_t> halfRow(
+			precision == ActivationPrecision::Half ? width : 0);
+
+	for (int channel = 0; channel < tensor.nChannels; channel++) {
+		for (int y = 0; y < tensor.tensorSize.height; y++) {
+			const float *src = planes[channel].ptr<float>(y);
+			if (precision == ActivationPrecision::Half) {
+				convertFloatToHalf(src, halfRow.data(), width);
+				uint16_t *dst = tensor.halfPtr(channel / C, y) + channel % C;
+				for (int x = 0; x < width; x++) {
+					dst[x * C] = halfRow[x];
+				}
+			} else {
+				float *dst = tensor.ptr(channel / C, y) + channel % C;
+				for (int x = 0; x < width; x++) {
+					dst[x * C] = src[x];
+				}
+			}
+		}
+	}
+
+	tensor.fillHalo();
+	return tensor;
+}
+
+ActivationTensor ActivationTensor::fromPlane(const cv::Mat &plane,
+		ActivationPrecision precision) {
+	return fromPlanes(std::vector<cv::Mat>(1, plane), precision);
+}
+
+void ActivationTensor::toPlanes(std::vector<cv::Mat> &planes) const {
+	planes.resize(nChannels);
+	for (int channel = 0; channel < nChannels; channel++) {
+		toPlane(channel, planes[channel]);
+	}
+}
+
+void ActivationTensor::toPlane(int channel, cv::Mat &plane) const {
+	const int C = tensorChannelBlock;
+	const int width = tensorSize.width;
+	plane.create(tensorSize, CV_32FC1);
+	std::vector<uint16_t> halfRow(
+			precision == ActivationPrecision::Half ? width : 0);
+
+	for (int y = 0; y < tensorSize.height; y++) {
+		float *dst = plane.ptr<float>(y);
+		if (precision == ActivationPrecision::Half) {
+			const uint16_t *src = halfPtr(channel / C, y) + channel % C;
+			for (int x = 0; x < width; x++) {
+				halfRow[x] = src[x * C];
+			}
+			convertHalfToFloat(halfRow.data(), dst, width);
+		} else {
+			const float *src = ptr(channel / C, y) + channel % C;
+			for (int x = 0; x < width; x++) {
+				dst[x] = src[x * C];
+			}
+		}
+	}
+}
+
+}
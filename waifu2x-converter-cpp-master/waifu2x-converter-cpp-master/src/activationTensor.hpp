@@ -0,0 +1,138 @@
+/*
+ * activationTensor.hpp
+ *   activation planes of a layer in channel-blocked (NCHWc) layout
+ *
+ *   Channels are interleaved in blocks of tensorChannelBlock, so that one
+ *   pixel of a block is tensorChannelBlock contiguous floats:
+ *     channel (b * tensorChannelBlock + c) of pixel (x, y) is at
+ *       ptr(b, y)[x * tensorChannelBlock + c]
+ *   Rows start at 64-byte boundaries, and each block has a halo of 1 pixel
+ *   around it, so that 3x3 kernels can read neighbours without clamping.
+ *   Channels in the padding of the last block are kept zero.
+ *
+ *   Elements are float, or IEEE half (to halve memory and traffic of planes
+ *   kept between layers). Kernels work on float only, see
+ *   Model::filter() for half tensors. Rounding of planes to half makes
+ *   output of a model differ from float planes (tolerance : 1e-3 absolute
+ *   on output of random models of the layer shapes of waifu2x, about
+ *   2.6e-4 measured; checked by compareKernels.cpp).
+ *
+ *   Like cv::Mat, copies and roi() share the storage.
+ */
+
+#ifndef ACTIVATION_TENSOR_HPP_
+#define ACTIVATION_TENSOR_HPP_
+
+#include <opencv2/opencv.hpp>
+#include "alignedBuffer.hpp"
+#include "packedWeights.hpp"
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace w2xc {
+
+// number of channels interleaved per pixel (same as output block of weights)
+constexpr int tensorChannelBlock = weightBlockSize;
+
+enum class ActivationPrecision {
+	Float, Half
+};
+
+class ActivationTensor {
+
+private:
+	std::shared_ptr<AlignedBuffer<float> > storage;
+	ActivationPrecision precision;
+	int nChannels;
+	int nBlocks;
+	cv::Size tensorSize;
+	int rowStride; // in elements
+	int blockStride; // in elements
+	unsigned char *origin; // pixel (0, 0) of block 0
+
+	int getElementSize() const {
+		return precision == ActivationPrecision::Half ? 2 : 4;
+	}
+	std::ptrdiff_t getOffset(int b, int y) const {
+		return (static_cast<std::ptrdiff_t>(b) * blockStride
+				+ static_cast<std::ptrdiff_t>(y) * rowStride) * getElementSize();
+	}
+
+public:
+	// width of halo (pixels readable outside of the tensor on each side)
+	static constexpr int halo = 1;
+
+	ActivationTensor();
+	// zero-cleared tensor (including halo)
+	ActivationTensor(int nChannels, cv::Size size,
+			ActivationPrecision precision = ActivationPrecision::Float);
+
+	int getNChannels() const {
+		return nChannels;
+	}
+	int getNBlocks() const {
+		return nBlocks;
+	}
+	cv::Size size() const {
+		return tensorSize;
+	}
+	bool empty() const {
+		return origin == nullptr;
+	}
+	ActivationPrecision getPrecision() const {
+		return precision;
+	}
+
+	// pixel 0 of row y in block b (y may be -halo to height - 1 + halo,
+	// and pixels -halo to width - 1 + halo of the row are readable)
+	// (float tensor only)
+	float *ptr(int b, int y) {
+		return reinterpret_cast<float *>(origin + getOffset(b, y));
+	}
+	const float *ptr(int b, int y) const {
+		return reinterpret_cast<const float *>(origin + getOffset(b, y));
+	}
+	// same as ptr(), for half tensor
+	uint16_t *halfPtr(int b, int y) {
+		return reinterpret_cast<uint16_t *>(origin + getOffset(b, y));
+	}
+	const uint16_t *halfPtr(int b, int y) const {
+		return reinterpret_cast<const uint16_t *>(origin + getOffset(b, y));
+	}
+
+	/**
+	 * region of this tensor sharing the storage.
+	 * halo of the region is made of surrounding pixels of this tensor
+	 * (and of this tensor's halo at its borders).
+	 */
+	ActivationTensor roi(cv::Rect rect) const;
+
+	/**
+	 * replicate border pixels into the halo (same as cv::BORDER_REPLICATE).
+	 * must be called after the pixels are written, before 3x3 kernels read.
+	 */
+	void fillHalo();
+
+	/**
+	 * copy nRows rows from srcRow of src to dstRow of dst, converting
+	 * precision (rows include halo pixels at both ends).
+	 * src and dst must have the same number of channels and width.
+	 */
+	static void convertRows(const ActivationTensor &src, int srcRow,
+			ActivationTensor &dst, int dstRow, int nRows);
+
+	// adapters from / to cv::Mat planes (CV_32FC1) at the image boundary
+	static ActivationTensor fromPlanes(const std::vector<cv::Mat> &planes,
+			ActivationPrecision precision = ActivationPrecision::Float);
+	static ActivationTensor fromPlane(const cv::Mat &plane,
+			ActivationPrecision precision = ActivationPrecision::Float);
+	void toPlanes(std::vector<cv::Mat> &planes) const;
+	void toPlane(int channel, cv::Mat &plane) const;
+
+};
+
+}
+
+#endif /* ACTIVATION_TENSOR_HPP_ */
@@ -0,0 +1,98 @@
+/*
+ * alignedBuffer.hpp
+ *   heap buffer aligned for SIMD loads (64 bytes : cache line / AVX-512)
+ */
+
+#ifndef ALIGNED_BUFFER_HPP_
+#define ALIGNED_BUFFER_HPP_
+
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <new>
+
+namespace w2xc {
+
+constexpr std::size_t bufferAlignment = 64;
+
+template<typename T>
+class AlignedBuffer {
+
+private:
+	void *rawPointer; // pointer returned from std::malloc
+	T *alignedPointer;
+	std::size_t count;
+
+	AlignedBuffer(const AlignedBuffer &) = delete;
+	AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+public:
+	AlignedBuffer() :
+			rawPointer(nullptr), alignedPointer(nullptr), count(0) {
+	}
+	explicit AlignedBuffer(std::size_t n) :
+			AlignedBuffer() {
+		resize(n);
+	}
+	AlignedBuffer(AlignedBuffer &&other) :
+			rawPointer(other.rawPointer), alignedPointer(other.alignedPointer),
+			count(other.count) {
+		other.rawPointer = nullptr;
+		other.alignedPointer = nullptr;
+		other.count = 0;
+	}
+	AlignedBuffer &operator=(AlignedBuffer &&other) {
+		std::swap(rawPointer, other.rawPointer);
+		std::swap(alignedPointer, other.alignedPointer);
+		std::swap(count, other.count);
+		return *this;
+	}
+	~AlignedBuffer() {
+		std::free(rawPointer);
+	}
+
+	// contents are discarded and zero-cleared
+	// (throws std::bad_alloc, then the buffer is empty)
+	void resize(std::size_t n) {
+		std::free(rawPointer);
+		rawPointer = nullptr;
+		alignedPointer = nullptr;
+		count = 0;
+		if (n > (std::numeric_limits<std::size_t>::max() - bufferAlignment)
+				/ sizeof(T)) {
+			throw std::bad_alloc();
+		}
+		rawPointer = std::malloc(n * sizeof(T) + bufferAlignment);
+		if (rawPointer == nullptr) {
+			throw std::bad_alloc();
+		}
+		std::uintptr_t address = reinterpret_cast<std::uintptr_t>(rawPointer);
+		address = (address + bufferAlignment - 1) & ~(bufferAlignment - 1);
+		alignedPointer = reinterpret_cast<T *>(address);
+		count = n;
+		std::memset(alignedPointer, 0, n * sizeof(T));
+	}
+
+	T *data() {
+		return alignedPointer;
+	}
+	const T *data() const {
+		return alignedPointer;
+	}
+	std::size_t size() const {
+		return count;
+	}
+	T &operator[](std::size_t index) {
+		return alignedPointer[index];
+	}
+	const T &operator[](std::size_t index) const {
+		return alignedPointer[index];
+	}
+
+};
+
+}
+
+#endif /* ALIGNED_BUFFER_HPP_ */
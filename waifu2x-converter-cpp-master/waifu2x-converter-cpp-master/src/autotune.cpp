@@ -0,0 +1,322 @@
+/*
+ * autotune.cpp
+ *   benchmark of execution settings of a model, and cache file of them
+ */
+
+#include "autotune.hpp"
+#include "convertRoutine.hpp"
+#include "cpuFeatures.hpp"
+#include "modelFormat.hpp"
+#include "errorReport.hpp"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <limits>
+#include <functional>
+#include <cstdint>
+
+namespace w2xc {
+
+// edge length of random input of layer benchmark
+static constexpr int tuningLayerSize = 128;
+// edge length of random image of block size benchmark
+// (convertWithModels() splits images larger than 1.5 times the area of a
+// block, so that all candidates split it, and are timed with the
+// overhead of splitting)
+static constexpr int tuningImageSize = 640;
+// each candidate is timed this many times after a warm-up run (best is used)
+static constexpr int tuningRepeats = 2;
+
+static const FilterBackend backendCandidates[] = { FilterBackend::Direct,
+		FilterBackend::GEMM, FilterBackend::Winograd };
+static const int tasksPerThreadCandidates[] = { 1, 2, 4, 8 };
+static const int blockSizeCandidates[] = { 128, 256, 512 };
+static_assert(tuningImageSize * tuningImageSize > 512 * 512 * 3 / 2,
+		"benchmark image must be split by the largest block size");
+
+std::string getFilterBackendName(FilterBackend backend) {
+	switch (backend) {
+	case FilterBackend::GEMM:
+		return "gemm";
+	case FilterBackend::Winograd:
+		return "winograd";
+	default:
+		return "direct";
+	}
+}
+
+bool parseFilterBackend(const std::string &name, FilterBackend &backend) {
+	for (auto&& candidate : backendCandidates) {
+		if (name == getFilterBackendName(candidate)) {
+			backend = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::string getTuningKey(const std::string &modelFileName, int nThreads) {
+	uint64_t hash;
+	if (!getFileHash(modelFileName, hash)) {
+		return "";
+	}
+
+	std::ostringstream key;
+	key << getCpuModelName() << ", "
+			<< getCpuFeatureLevelName(getCpuFeatureLevel()) << ", "
+			<< nThreads << " threads, "
+			<< std::hex << std::setw(16) << std::setfill('0') << hash;
+	return key.str();
+}
+
+// best time of tuningRepeats runs in seconds (after a warm-up run)
+static double measure(const std::function<bool()> &run) {
+	if (!run()) {
+		return std::numeric_limits<double>::max();
+	}
+	double best = std::numeric_limits<double>::max();
+	for (int i = 0; i < tuningRepeats; i++) {
+		auto start = std::chrono::steady_clock::now();
+		run();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best,
+				std::chrono::duration<double>(end - start).count());
+	}
+	return best;
+}
+
+static LayerPlan autotuneLayer(Model &model, ThreadPool *pool,
+		std::mt19937 &rng) {
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+	cv::Size size(tuningLayerSize, tuningLayerSize);
+	ActivationTensor input(model.getNInputPlanes(), size);
+	for (int ipIndex = 0; ipIndex < model.getNInputPlanes(); ipIndex++) {
+		for (int y = 0; y < size.height; y++) {
+			float *row = input.ptr(ipIndex / tensorChannelBlock, y)
+					+ ipIndex % tensorChannelBlock;
+			for (int x = 0; x < size.width; x++) {
+				row[x * tensorChannelBlock] = distribution(rng);
+			}
+		}
+	}
+	input.fillHalo();
+	ActivationTensor output;
+	auto run = [&]() {
+		return model.filter(input, output, pool);
+	};
+
+	LayerPlan best = { model.getBackend(), model.getTasksPerThread() };
+	double bestTime = std::numeric_limits<double>::max();
+
+	// backend with default granularity, then granularity of the winner
+	model.setTasksPerThread(defaultTasksPerThread);
+	for (auto&& backend : backendCandidates) {
+		if (!model.setBackend(backend))
+			continue;
+		double time = measure(run);
+		if (time < bestTime) {
+			bestTime = time;
+			best.backend = backend;
+		}
+	}
+	model.setBackend(best.backend);
+	best.tasksPerThread = defaultTasksPerThread;
+	for (auto&& tasksPerThread : tasksPerThreadCandidates) {
+		if (tasksPerThread == defaultTasksPerThread)
+			continue;
+		model.setTasksPerThread(tasksPerThread);
+		double time = measure(run);
+		if (time < bestTime) {
+			bestTime = time;
+			best.tasksPerThread = tasksPerThread;
+		}
+	}
+	model.setTasksPerThread(best.tasksPerThread);
+
+	return best;
+}
+
+bool autotuneModels(std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context, ExecutionPlan &plan) {
+
+	std::mt19937 rng(1);
+	plan.layers.clear();
+	for (std::size_t index = 0; index < models.size(); index++) {
+		plan.layers.push_back(autotuneLayer(*models[index],
+				context.threadPool, rng));
+		std::cout << "layer #" << (index + 1) << " : "
+				<< getFilterBackendName(plan.layers.back().backend) << ", "
+				<< plan.layers.back().tasksPerThread << " tasks per thread"
+				<< std::endl;
+	}
+
+	// block size matters only in block splitting execution
+	plan.blockSize = context.blockSize;
+	if (context.streaming || context.tileFusion) {
+		return true;
+	}
+
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+	cv::Mat image(cv::Size(tuningImageSize, tuningImageSize), CV_32FC1);
+	for (int y = 0; y < image.rows; y++) {
+		float *row = image.ptr<float>(y);
+		for (int x = 0; x < image.cols; x++) {
+			row[x] = distribution(rng);
+		}
+	}
+	cv::Mat output;
+
+	ExecutionContext candidateContext = context;
+	candidateContext.verbose = false;
+	double bestTime = std::numeric_limits<double>::max();
+	for (auto&& length : blockSizeCandidates) {
+		candidateContext.blockSize = cv::Size(length, length);
+		auto start = std::chrono::steady_clock::now();
+		if (!convertWithModels(image, output, models, candidateContext)) {
+			return false;
+		}
+		auto end = std::chrono::steady_clock::now();
+		double time = std::chrono::duration<double>(end - start).count();
+		if (time < bestTime) {
+			bestTime = time;
+			plan.blockSize = cv::Size(length, length);
+		}
+	}
+	std::cout << "block size : " << plan.blockSize.width << std::endl;
+
+	return true;
+}
+
+bool applyExecutionPlan(const ExecutionPlan &plan,
+		std::vector<std::unique_ptr<Model> > &models) {
+	// whole plan is checked before models are changed
+	if (plan.layers.size() != models.size()
+			|| plan.blockSize.width <= 2 * static_cast<int>(models.size())
+			|| plan.blockSize.height <= 2 * static_cast<int>(models.size())) {
+		return false;
+	}
+	for (std::size_t index = 0; index < models.size(); index++) {
+		// GEMM and Winograd backend support only 3x3 kernel
+		if ((plan.layers[index].backend != FilterBackend::Direct
+				&& models[index]->getKernelSize() != 3)
+				|| plan.layers[index].tasksPerThread < 1) {
+			return false;
+		}
+	}
+
+	for (std::size_t index = 0; index < models.size(); index++) {
+		models[index]->setBackend(plan.layers[index].backend);
+		models[index]->setTasksPerThread(plan.layers[index].tasksPerThread);
+	}
+	return true;
+}
+
+// whole cache file (empty object if it doesn't exist)
+static bool readCacheFile(const std::string &cacheFileName,
+		picojson::object &plans) {
+	std::ifstream jsonFile(cacheFileName);
+	if (!jsonFile.is_open()) {
+		plans.clear();
+		return true;
+	}
+
+	picojson::value jsonValue;
+	jsonFile >> jsonValue;
+	std::string errMsg = picojson::get_last_error();
+	if (!errMsg.empty() || !jsonValue.is<picojson::object>()) {
+		reportError(cacheFileName + " is not a tuning cache file");
+		return false;
+	}
+	plans = jsonValue.get<picojson::object>();
+	return true;
+}
+
+bool loadExecutionPlan(const std::string &cacheFileName,
+		const std::string &key, ExecutionPlan &plan) {
+
+	picojson::object plans;
+	if (!readCacheFile(cacheFileName, plans) || plans.count(key) == 0) {
+		return false;
+	}
+
+	// entries may be edited by hand, so types are checked
+	if (!plans[key].is<picojson::object>()) {
+		reportError(cacheFileName + " is not a tuning cache file");
+		return false;
+	}
+	picojson::object &obj = plans[key].get<picojson::object>();
+	if (!obj["blockSize"].is<double>() || !obj["layers"].is<picojson::array>()) {
+		reportError(cacheFileName + " is not a tuning cache file");
+		return false;
+	}
+	picojson::array &layerArray = obj["layers"].get<picojson::array>();
+	double length = obj["blockSize"].get<double>();
+	// a block must be larger than the padding of all layers
+	if (!(length > 2.0 * layerArray.size()) || length > (1 << 16)) {
+		reportError("invalid block size in " + cacheFileName);
+		return false;
+	}
+	plan.blockSize = cv::Size(static_cast<int>(length),
+			static_cast<int>(length));
+	plan.layers.clear();
+	for (auto&& layerValue : layerArray) {
+		if (!layerValue.is<picojson::object>()) {
+			reportError(cacheFileName + " is not a tuning cache file");
+			return false;
+		}
+		picojson::object layerObj = layerValue.get<picojson::object>();
+		if (!layerObj["backend"].is<std::string>()
+				|| !layerObj["tasksPerThread"].is<double>()) {
+			reportError(cacheFileName + " is not a tuning cache file");
+			return false;
+		}
+		LayerPlan layer;
+		if (!parseFilterBackend(layerObj["backend"].get<std::string>(),
+				layer.backend)) {
+			reportError("unknown backend in " + cacheFileName);
+			return false;
+		}
+		layer.tasksPerThread =
+				static_cast<int>(layerObj["tasksPerThread"].get<double>());
+		plan.layers.push_back(layer);
+	}
+
+	return true;
+}
+
+bool saveExecutionPlan(const std::string &cacheFileName,
+		const std::string &key, const ExecutionPlan &plan) {
+
+	picojson::object plans;
+	if (!readCacheFile(cacheFileName, plans)) {
+		return false;
+	}
+
+	picojson::array layerArray;
+	for (auto&& layer : plan.layers) {
+		picojson::object layerObj;
+		layerObj["backend"] = picojson::value(
+				getFilterBackendName(layer.backend));
+		layerObj["tasksPerThread"] = picojson::value(
+				static_cast<double>(layer.tasksPerThread));
+		layerArray.push_back(picojson::value(layerObj));
+	}
+	picojson::object obj;
+	obj["blockSize"] = picojson::value(
+			static_cast<double>(plan.blockSize.width));
+	obj["layers"] = picojson::value(layerArray);
+	plans[key] = picojson::value(obj);
+
+	std::ofstream jsonFile(cacheFileName);
+	if (!jsonFile.is_open()) {
+		reportError("couldn't open " + cacheFileName);
+		return false;
+	}
+	jsonFile << picojson::value(plans).serialize(true) << std::endl;
+
+	return true;
+}
+
+}
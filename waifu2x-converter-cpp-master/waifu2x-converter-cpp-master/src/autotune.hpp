@@ -0,0 +1,71 @@
+/*
+ * autotune.hpp
+ *   benchmark of execution settings of a model, and cache file of them
+ *
+ *   For each layer, backends (direct, GEMM, Winograd) and granularity of
+ *   the split into tasks (Model::setTasksPerThread()) are timed on random
+ *   input, then block size of block splitting is timed on conversion with
+ *   all layers. The winners (execution plan) are saved in a cache file
+ *   with a key of CPU model, kernel level, number of threads and hash of
+ *   the model file, so that later runs on the same machine apply them
+ *   without benchmark.
+ *   (register tile of direct kernels is fixed at compile time and the same
+ *    for all shapes, see filterKernelsSpecialized.cpp)
+ */
+
+#ifndef AUTOTUNE_HPP_
+#define AUTOTUNE_HPP_
+
+#include "modelHandler.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+
+namespace w2xc {
+
+struct LayerPlan {
+	FilterBackend backend;
+	int tasksPerThread;
+};
+
+struct ExecutionPlan {
+	cv::Size blockSize;
+	std::vector<LayerPlan> layers;
+};
+
+// "direct", "gemm", "winograd"
+std::string getFilterBackendName(FilterBackend backend);
+// returns false for unknown name
+bool parseFilterBackend(const std::string &name, FilterBackend &backend);
+
+/**
+ * key of the plan of model file on this machine with nThreads threads
+ * (empty if the model file cannot be read). plans depend on kernel level,
+ * so set it before.
+ */
+std::string getTuningKey(const std::string &modelFileName, int nThreads);
+
+// benchmark candidates on context, and leave models set to the winners
+// (block size of context is not changed, the winner is plan.blockSize)
+bool autotuneModels(std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context, ExecutionPlan &plan);
+
+// set backends and task split of the plan to models
+// (block size of the plan is applied by caller to its execution context)
+// returns false if the plan doesn't fit models (then models are not
+// changed)
+bool applyExecutionPlan(const ExecutionPlan &plan,
+		std::vector<std::unique_ptr<Model> > &models);
+
+// cache file is a JSON object of plans by key
+// loadExecutionPlan returns false if the file or the key doesn't exist,
+// or the plan is broken (reported)
+bool loadExecutionPlan(const std::string &cacheFileName,
+		const std::string &key, ExecutionPlan &plan);
+// (other plans in the file are kept)
+bool saveExecutionPlan(const std::string &cacheFileName,
+		const std::string &key, const ExecutionPlan &plan);
+
+}
+
+#endif /* AUTOTUNE_HPP_ */
@@ -0,0 +1,72 @@
+/*
+ * boundedQueue.hpp
+ *   blocking queue of limited length between stages of a pipeline
+ */
+
+#ifndef BOUNDED_QUEUE_HPP_
+#define BOUNDED_QUEUE_HPP_
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+
+namespace w2xc {
+
+template<typename T>
+class BoundedQueue {
+
+private:
+	std::deque<T> items;
+	std::size_t capacity;
+	bool closed;
+	std::mutex mtx;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+
+	BoundedQueue(const BoundedQueue &) = delete;
+	BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+public:
+	// capacity : number of items waiting at most (at least 1)
+	explicit BoundedQueue(std::size_t capacity) :
+			capacity(capacity > 0 ? capacity : 1), closed(false) {
+	}
+
+	// wait while queue is full. returns false if queue is closed.
+	bool push(T item) {
+		std::unique_lock<std::mutex> lock(mtx);
+		notFull.wait(lock, [this] {return closed || items.size() < capacity;});
+		if (closed)
+			return false;
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+		return true;
+	}
+
+	// wait while queue is empty.
+	// returns false when queue is closed and all items have been taken.
+	bool pop(T &item) {
+		std::unique_lock<std::mutex> lock(mtx);
+		notEmpty.wait(lock, [this] {return closed || !items.empty();});
+		if (items.empty())
+			return false;
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	// no more items (items in queue can still be taken)
+	void close() {
+		std::lock_guard<std::mutex> lock(mtx);
+		closed = true;
+		notFull.notify_all();
+		notEmpty.notify_all();
+	}
+
+};
+
+}
+
+#endif /* BOUNDED_QUEUE_HPP_ */
@@ -0,0 +1,159 @@
+/*
+ * calibrateInt8.cpp
+ *   calibration tool of INT8 mode (separate executable)
+ *
+ *   Runs the float model over sample images, records the range of input
+ *   of each layer, and writes it to calibration file next to model file
+ *   (see modelUtility::getInt8CalibrationFileName()).
+ *   Then converts the same images in INT8 mode and reports PSNR of Y
+ *   channel against the float path, to decide whether quantization of the
+ *   model is acceptable.
+ *
+ *   usage : calibrateInt8 -m models/scale2.0x_model.json --scale a.png b.png
+ */
+
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "tclap/CmdLine.h"
+
+#include "modelHandler.hpp"
+#include "convertRoutine.hpp"
+#include "imageConversion.hpp"
+#include "cpuFeatures.hpp"
+
+// Y channel of image, as main.cpp feeds to models
+static bool loadImageY(const std::string &fileName, bool scale, cv::Mat &imageY) {
+	w2xc::PlanarImage image;
+	if (!w2xc::decodeImage(fileName, image, nullptr))
+		return false;
+	if (scale) {
+		cv::resize(image.y, imageY, cv::Size(image.y.cols * 2,
+				image.y.rows * 2), 0, 0, cv::INTER_NEAREST);
+	} else {
+		imageY = image.y;
+	}
+	return true;
+}
+
+// widen ranges by input of each layer over whole image
+static void observeRanges(const cv::Mat &imageY,
+		std::vector<std::unique_ptr<w2xc::Model> > &models,
+		std::vector<w2xc::ActivationRange> &ranges) {
+	w2xc::ActivationTensor input = w2xc::ActivationTensor::fromPlane(imageY);
+	w2xc::ActivationTensor output;
+
+	for (std::size_t index = 0; index < models.size(); index++) {
+		std::vector<cv::Mat> planes;
+		input.toPlanes(planes);
+		for (auto&& plane : planes) {
+			double minValue, maxValue;
+			cv::minMaxLoc(plane, &minValue, &maxValue);
+			ranges[index].min = std::min(ranges[index].min,
+					static_cast<float>(minValue));
+			ranges[index].max = std::max(ranges[index].max,
+					static_cast<float>(maxValue));
+		}
+		models[index]->filter(input, output);
+		input = output;
+	}
+}
+
+// PSNR of outputs clamped to [0, 1] (as written to 8-bit image)
+static double getPSNR(const cv::Mat &reference, const cv::Mat &target) {
+	cv::Mat a = cv::max(reference, 0.0);
+	cv::Mat b = cv::max(target, 0.0);
+	cv::Mat diff = cv::min(a, 1.0) - cv::min(b, 1.0);
+	double mse = diff.dot(diff) / static_cast<double>(diff.total());
+	if (mse <= 0.0)
+		return std::numeric_limits<double>::infinity();
+	return 10.0 * std::log10(1.0 / mse);
+}
+
+int main(int argc, char** argv) {
+
+	TCLAP::CmdLine cmd("calibration of INT8 mode of waifu2x", ' ', "1.0.0");
+
+	TCLAP::ValueArg<std::string> cmdModelFile("m", "model_file",
+			"path to model file (JSON)", true, "", "string", cmd);
+
+	TCLAP::SwitchArg cmdScale("", "scale",
+			"model is 2x scaling model (images are enlarged before it)", cmd,
+			false);
+
+	TCLAP::ValueArg<int> cmdNumberOfJobs("j", "jobs",
+			"number of threads launching at the same time", false, 4, "integer",
+			cmd);
+
+	TCLAP::UnlabeledMultiArg<std::string> cmdImageFiles("images",
+			"sample image files", true, "string", cmd);
+
+	try {
+		cmd.parse(argc, argv);
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		std::cerr << "Error : cmd.parse() threw exception" << std::endl;
+		std::exit(-1);
+	}
+
+	w2xc::modelUtility::getInstance().setNumberOfJobs(cmdNumberOfJobs.getValue());
+
+	std::vector<std::unique_ptr<w2xc::Model> > models;
+	if (!w2xc::modelUtility::generateModelFromJSON(cmdModelFile.getValue(),
+			models))
+		std::exit(-1);
+
+	// ===== calibration (float path) =====
+	std::vector<cv::Mat> imagesY;
+	std::vector<w2xc::ActivationRange> ranges(models.size(),
+			w2xc::ActivationRange { std::numeric_limits<float>::max(),
+					std::numeric_limits<float>::lowest() });
+	for (auto&& fileName : cmdImageFiles.getValue()) {
+		cv::Mat imageY;
+		if (!loadImageY(fileName, cmdScale.getValue(), imageY))
+			std::exit(-1);
+		std::cout << "calibrating with " << fileName << std::endl;
+		observeRanges(imageY, models, ranges);
+		imagesY.push_back(imageY);
+	}
+
+	std::string calibrationFileName =
+			w2xc::modelUtility::getInt8CalibrationFileName(
+					cmdModelFile.getValue());
+	if (!w2xc::modelUtility::saveInt8Calibration(calibrationFileName, ranges))
+		std::exit(-1);
+	std::cout << "calibration is written to " << calibrationFileName
+			<< std::endl;
+
+	// ===== PSNR of INT8 path against float path =====
+	std::cout << "INT8 kernel : "
+			<< w2xc::getCpuFeatureLevelName(w2xc::getCpuFeatureLevel())
+			<< std::endl;
+	double sumPSNR = 0.0;
+	for (std::size_t index = 0; index < imagesY.size(); index++) {
+		cv::Mat floatOutput = imagesY[index].clone();
+		cv::Mat int8Output = imagesY[index].clone();
+
+		for (auto&& model : models) {
+			model->clearInt8Quantization();
+		}
+		w2xc::convertWithModels(imagesY[index], floatOutput, models);
+
+		if (!w2xc::modelUtility::loadInt8Calibration(calibrationFileName,
+				models))
+			std::exit(-1);
+		w2xc::convertWithModels(imagesY[index], int8Output, models);
+
+		double psnr = getPSNR(floatOutput, int8Output);
+		sumPSNR += psnr;
+		std::cout << cmdImageFiles.getValue()[index] << " : PSNR " << psnr
+				<< " dB" << std::endl;
+	}
+	std::cout << "mean PSNR : " << sumPSNR / imagesY.size() << " dB"
+			<< std::endl;
+
+	return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * colorConversion.cpp
+ *   conversion between 8-bit BGR pixels and YUV float planes
+ */
+
+#include "colorConversion.hpp"
+#include "cpuFeatures.hpp"
+#include <algorithm>
+#include <cmath>
+
+#ifdef W2XC_X86
+#include <immintrin.h>
+#endif
+
+namespace w2xc {
+
+// coefficients of Y including normalization of 8-bit value
+static constexpr float scaleR = 0.299f / 255.0f;
+static constexpr float scaleG = 0.587f / 255.0f;
+static constexpr float scaleB = 0.114f / 255.0f;
+static constexpr float normalization = 1.0f / 255.0f;
+static constexpr float scaleU = 0.492f;
+static constexpr float scaleV = 0.877f;
+
+// coefficients of B, G and R from chroma
+static constexpr float coefUB = 2.032f;
+static constexpr float coefUG = -0.395f;
+static constexpr float coefVG = -0.581f;
+static constexpr float coefVR = 1.140f;
+
+#ifdef W2XC_X86
+
+// 8 pixels of BGR (24 bytes) are loaded as 16 + 8 bytes, and each channel
+// is gathered into 8 bytes by shuffles of both parts
+W2XC_TARGET("avx2")
+static int convertBGRToYUVAVX2(const unsigned char *bgr, float *y, float *u,
+		float *v, int n) {
+	const __m128i shuffleLo[3] = {
+			_mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1,
+					-1, -1, -1, -1, -1, -1, -1, -1),
+			_mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1,
+					-1, -1, -1, -1, -1, -1, -1, -1),
+			_mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1,
+					-1, -1, -1, -1, -1, -1, -1, -1) };
+	const __m128i shuffleHi[3] = {
+			_mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5,
+					-1, -1, -1, -1, -1, -1, -1, -1),
+			_mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6,
+					-1, -1, -1, -1, -1, -1, -1, -1),
+			_mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7,
+					-1, -1, -1, -1, -1, -1, -1, -1) };
+	const __m256 coefR = _mm256_set1_ps(scaleR);
+	const __m256 coefG = _mm256_set1_ps(scaleG);
+	const __m256 coefB = _mm256_set1_ps(scaleB);
+	const __m256 coefN = _mm256_set1_ps(normalization);
+	const __m256 coefU = _mm256_set1_ps(scaleU);
+	const __m256 coefV = _mm256_set1_ps(scaleV);
+	const __m256 half = _mm256_set1_ps(0.5f);
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		const unsigned char *p = bgr + i * 3;
+		__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		__m128i hi = _mm_loadl_epi64(
+				reinterpret_cast<const __m128i *>(p + 16));
+		__m256 channels[3];
+		for (int c = 0; c < 3; c++) {
+			__m128i bytes = _mm_or_si128(_mm_shuffle_epi8(lo, shuffleLo[c]),
+					_mm_shuffle_epi8(hi, shuffleHi[c]));
+			channels[c] = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+		}
+		__m256 b = channels[0], g = channels[1], r = channels[2];
+
+		__m256 luma = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(r, coefR),
+						_mm256_mul_ps(g, coefG)), _mm256_mul_ps(b, coefB));
+		_mm256_storeu_ps(y + i, luma);
+		if (u != nullptr) {
+			__m256 blue = _mm256_mul_ps(b, coefN);
+			__m256 red = _mm256_mul_ps(r, coefN);
+			_mm256_storeu_ps(u + i, _mm256_add_ps(
+					_mm256_mul_ps(_mm256_sub_ps(blue, luma), coefU), half));
+			_mm256_storeu_ps(v + i, _mm256_add_ps(
+					_mm256_mul_ps(_mm256_sub_ps(red, luma), coefV), half));
+		}
+	}
+	return i;
+}
+
+// 8 pixels of B, G and R (8 bytes each, interleaved into 24 bytes) are
+// stored as 16 + 8 bytes, made by shuffles of B and G (16 bytes) and R
+W2XC_TARGET("avx2")
+static inline void storeBGR(unsigned char *p, __m128i b, __m128i g,
+		__m128i r) {
+	const __m128i shuffleBGLo = _mm_setr_epi8(0, 8, -1, 1, 9, -1, 2, 10,
+			-1, 3, 11, -1, 4, 12, -1, 5);
+	const __m128i shuffleRLo = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1,
+			2, -1, -1, 3, -1, -1, 4, -1);
+	const __m128i shuffleBGHi = _mm_setr_epi8(13, -1, 6, 14, -1, 7, 15, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i shuffleRHi = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7,
+			-1, -1, -1, -1, -1, -1, -1, -1);
+	__m128i bg = _mm_unpacklo_epi64(b, g);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(p),
+			_mm_or_si128(_mm_shuffle_epi8(bg, shuffleBGLo),
+					_mm_shuffle_epi8(r, shuffleRLo)));
+	_mm_storel_epi64(reinterpret_cast<__m128i *>(p + 16),
+			_mm_or_si128(_mm_shuffle_epi8(bg, shuffleBGHi),
+					_mm_shuffle_epi8(r, shuffleRHi)));
+}
+
+// normalized value to 8 bytes (low half), rounded and saturated
+W2XC_TARGET("avx2")
+static inline __m128i toBytes(__m256 value) {
+	const __m256 scale = _mm256_set1_ps(255.0f);
+	value = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(value, scale),
+			_mm256_setzero_ps()), scale);
+	__m256i words = _mm256_cvtps_epi32(value);
+	__m128i shorts = _mm_packus_epi32(_mm256_castsi256_si128(words),
+			_mm256_extracti128_si256(words, 1));
+	return _mm_packus_epi16(shorts, shorts);
+}
+
+W2XC_TARGET("avx2")
+static int convertYUVToBGRAVX2(const float *y, const float *u,
+		const float *v, unsigned char *bgr, int n) {
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 ub = _mm256_set1_ps(coefUB);
+	const __m256 ug = _mm256_set1_ps(coefUG);
+	const __m256 vg = _mm256_set1_ps(coefVG);
+	const __m256 vr = _mm256_set1_ps(coefVR);
+
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		__m256 luma = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(y + i),
+				zero), one);
+		if (u == nullptr) {
+			_mm_storel_epi64(reinterpret_cast<__m128i *>(bgr + i),
+					toBytes(luma));
+			continue;
+		}
+		__m256 cu = _mm256_sub_ps(_mm256_loadu_ps(u + i), half);
+		__m256 cv = _mm256_sub_ps(_mm256_loadu_ps(v + i), half);
+		__m256 b = _mm256_add_ps(luma, _mm256_mul_ps(cu, ub));
+		__m256 g = _mm256_add_ps(_mm256_add_ps(luma, _mm256_mul_ps(cu, ug)),
+				_mm256_mul_ps(cv, vg));
+		__m256 r = _mm256_add_ps(luma, _mm256_mul_ps(cv, vr));
+		storeBGR(bgr + i * 3, toBytes(b), toBytes(g), toBytes(r));
+	}
+	return i;
+}
+
+#endif
+
+void convertBGRToYUV(const unsigned char *bgr, float *y, float *u, float *v,
+		int n) {
+	int i = 0;
+#ifdef W2XC_X86
+	if (getCpuFeatureLevel() >= CpuFeatureLevel::AVX2) {
+		i = convertBGRToYUVAVX2(bgr, y, u, v, n);
+	}
+#endif
+	for (; i < n; i++) {
+		float b = bgr[i * 3], g = bgr[i * 3 + 1], r = bgr[i * 3 + 2];
+		float luma = r * scaleR + g * scaleG + b * scaleB;
+		y[i] = luma;
+		if (u != nullptr) {
+			u[i] = (b * normalization - luma) * scaleU + 0.5f;
+			v[i] = (r * normalization - luma) * scaleV + 0.5f;
+		}
+	}
+}
+
+// normalized value to 8-bit, rounded and saturated
+static inline unsigned char toByte(float value) {
+	return static_cast<unsigned char>(std::lrint(
+			std::min(std::max(value * 255.0f, 0.0f), 255.0f)));
+}
+
+void convertYUVToBGR(const float *y, const float *u, const float *v,
+		unsigned char *bgr, int n) {
+	int i = 0;
+#ifdef W2XC_X86
+	if (getCpuFeatureLevel() >= CpuFeatureLevel::AVX2) {
+		i = convertYUVToBGRAVX2(y, u, v, bgr, n);
+	}
+#endif
+	for (; i < n; i++) {
+		float luma = std::min(std::max(y[i], 0.0f), 1.0f);
+		if (u == nullptr) {
+			bgr[i] = toByte(luma);
+			continue;
+		}
+		float cu = u[i] - 0.5f, cv = v[i] - 0.5f;
+		bgr[i * 3] = toByte(luma + cu * coefUB);
+		bgr[i * 3 + 1] = toByte(luma + cu * coefUG + cv * coefVG);
+		bgr[i * 3 + 2] = toByte(luma + cv * coefVR);
+	}
+}
+
+}
@@ -0,0 +1,42 @@
+/*
+ * colorConversion.hpp
+ *   conversion between 8-bit BGR pixels and YUV float planes
+ *
+ *   Y = .299 R + .587 G + .114 B
+ *   U = (B - Y) * .492 + .5
+ *   V = (R - Y) * .877 + .5
+ *   and back
+ *   B = Y + 2.032 (U - .5)
+ *   G = Y - .395 (U - .5) - .581 (V - .5)
+ *   R = Y + 1.140 (V - .5)
+ *   (R, G, B and Y normalized to [0, 1])
+ *
+ *   AVX2 is used on AVX2 level (see cpuFeatures.hpp), scalar conversion
+ *   otherwise. Both compute in the same order, so results are the same.
+ */
+
+#ifndef COLOR_CONVERSION_HPP_
+#define COLOR_CONVERSION_HPP_
+
+namespace w2xc {
+
+/**
+ * convert n pixels of packed 8-bit BGR into Y, U and V.
+ * u and v may be nullptr, then only Y is computed (grayscale image).
+ */
+void convertBGRToYUV(const unsigned char *bgr, float *y, float *u, float *v,
+		int n);
+
+/**
+ * convert n pixels of Y, U and V into packed 8-bit BGR.
+ * Y is clamped to [0, 1], and B, G and R are rounded to nearest (even)
+ * and saturated, same as convertTo(CV_8U).
+ * u and v may be nullptr, then 8-bit gray pixels (1 byte each) are
+ * written.
+ */
+void convertYUVToBGR(const float *y, const float *u, const float *v,
+		unsigned char *bgr, int n);
+
+}
+
+#endif /* COLOR_CONVERSION_HPP_ */
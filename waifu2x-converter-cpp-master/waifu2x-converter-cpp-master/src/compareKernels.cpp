@@ -0,0 +1,340 @@
+/*
+ * compareKernels.cpp
+ *   comparison of kernel levels and reduced precision modes (separate
+ *   executable)
+ *
+ *   Runs a random 3x3 layer of each shape of waifu2x models with the
+ *   direct backend on every kernel level supported by the CPU (see
+ *   cpuFeatures.hpp), and compares the output with the scalar level, on
+ *   widths which are not multiples of SIMD width (border columns are in
+ *   every row). The tolerance is the one of filterKernels.hpp. The same
+ *   is done in INT8 mode (levels differ only by rounding of
+ *   dequantization).
+ *   Model::filterUpsampled2x() is compared with filter() on the padded
+ *   upscaled plane too, on odd sizes and regions at the edges.
+ *   Then runs a random model of all these layers in INT8 mode (calibrated
+ *   through calibration file) and with half activations, and compares the
+ *   output with the float path, against the bounds of quantization.hpp
+ *   and activationTensor.hpp.
+ *
+ *   Exits with -1 if any comparison exceeds its bound.
+ *
+ *   usage : compareKernels
+ */
+
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <limits>
+#include <algorithm>
+
+#include "modelHandler.hpp"
+#include "convertRoutine.hpp"
+#include "cpuFeatures.hpp"
+
+// bounds (maximum absolute error) documented in the headers
+static const double kernelTolerance = 1e-5; // filterKernels.hpp
+static const double int8Tolerance = 0.03; // quantization.hpp
+static const double halfTolerance = 1e-3; // activationTensor.hpp
+
+// input and output planes of 3x3 layers of waifu2x models
+static const int modelPlanes[] = { 1, 32, 32, 64, 64, 128, 128, 1 };
+static const int nModelLayers = sizeof(modelPlanes) / sizeof(modelPlanes[0])
+		- 1;
+
+static std::mt19937 randomEngine(1);
+
+// weights scaled so that outputs are of order 1 for inputs of order 1
+static std::unique_ptr<w2xc::Model> makeRandomLayer(int nInputPlanes,
+		int nOutputPlanes) {
+	std::normal_distribution<float> distribution(0.0f, 1.0f);
+	float scale = 1.0f / std::sqrt(9.0f * nInputPlanes);
+
+	std::vector<float> weights(nOutputPlanes * nInputPlanes * 9);
+	for (auto&& w : weights) {
+		w = distribution(randomEngine) * scale;
+	}
+	std::vector<float> biases(nOutputPlanes);
+	for (auto&& b : biases) {
+		b = distribution(randomEngine) * 0.1f;
+	}
+
+	return std::unique_ptr<w2xc::Model>(new w2xc::Model(nInputPlanes,
+			nOutputPlanes, 3, weights.data(), biases.data()));
+}
+
+static cv::Mat makeRandomPlane(cv::Size size) {
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+	cv::Mat plane(size, CV_32FC1);
+	for (int y = 0; y < size.height; y++) {
+		float *row = plane.ptr<float>(y);
+		for (int x = 0; x < size.width; x++) {
+			row[x] = distribution(randomEngine);
+		}
+	}
+	return plane;
+}
+
+static double getMaxError(const cv::Mat &reference, const cv::Mat &target) {
+	double maxError = 0.0;
+	for (int y = 0; y < reference.rows; y++) {
+		const float *referenceRow = reference.ptr<float>(y);
+		const float *targetRow = target.ptr<float>(y);
+		for (int x = 0; x < reference.cols; x++) {
+			maxError = std::max(maxError, static_cast<double>(
+					std::fabs(referenceRow[x] - targetRow[x])));
+		}
+	}
+	return maxError;
+}
+
+static double getMaxError(const w2xc::ActivationTensor &reference,
+		const w2xc::ActivationTensor &target) {
+	std::vector<cv::Mat> referencePlanes, targetPlanes;
+	reference.toPlanes(referencePlanes);
+	target.toPlanes(targetPlanes);
+
+	double maxError = 0.0;
+	for (std::size_t index = 0; index < referencePlanes.size(); index++) {
+		maxError = std::max(maxError,
+				getMaxError(referencePlanes[index], targetPlanes[index]));
+	}
+	return maxError;
+}
+
+static bool report(const std::string &name, double error, double bound) {
+	bool passed = error <= bound;
+	std::cout << name << " : max error " << error << " (bound " << bound
+			<< ")" << (passed ? "" : " FAILED") << std::endl;
+	return passed;
+}
+
+static std::vector<w2xc::CpuFeatureLevel> getSupportedLevels() {
+	const w2xc::CpuFeatureLevel allLevels[] = {
+		w2xc::CpuFeatureLevel::Scalar, w2xc::CpuFeatureLevel::Universal,
+		w2xc::CpuFeatureLevel::SSE41, w2xc::CpuFeatureLevel::AVX2,
+		w2xc::CpuFeatureLevel::AVX512, w2xc::CpuFeatureLevel::AVX512VNNI
+	};
+	w2xc::CpuFeatureLevel detected = w2xc::detectCpuFeatureLevel();
+
+	std::vector<w2xc::CpuFeatureLevel> levels;
+	for (auto&& level : allLevels) {
+		if (level <= detected && w2xc::setCpuFeatureLevel(level)) {
+			levels.push_back(level);
+		}
+	}
+	w2xc::setCpuFeatureLevel(detected);
+	return levels;
+}
+
+// each layer shape on each level against scalar level
+static bool compareLayers(
+		const std::vector<w2xc::CpuFeatureLevel> &levels) {
+	// (1 pixel, less than a SIMD register, and not multiples of 8 or 16)
+	const int widths[] = { 1, 5, 13, 37, 70 };
+	const int height = 5;
+	bool passed = true;
+
+	for (int index = 0; index < nModelLayers; index++) {
+		int nInputPlanes = modelPlanes[index];
+		int nOutputPlanes = modelPlanes[index + 1];
+		std::unique_ptr<w2xc::Model> layer = makeRandomLayer(nInputPlanes,
+				nOutputPlanes);
+		layer->setBackend(w2xc::FilterBackend::Direct);
+
+		for (int width : widths) {
+			std::vector<cv::Mat> planes;
+			for (int plane = 0; plane < nInputPlanes; plane++) {
+				planes.push_back(makeRandomPlane(cv::Size(width, height)));
+			}
+			w2xc::ActivationTensor input =
+					w2xc::ActivationTensor::fromPlanes(planes);
+
+			w2xc::setCpuFeatureLevel(w2xc::CpuFeatureLevel::Scalar);
+			w2xc::ActivationTensor reference;
+			layer->filter(input, reference, nullptr);
+
+			for (auto&& level : levels) {
+				w2xc::setCpuFeatureLevel(level);
+				w2xc::ActivationTensor output;
+				layer->filter(input, output, nullptr);
+
+				std::string name = std::to_string(nInputPlanes) + "->"
+						+ std::to_string(nOutputPlanes) + ", width "
+						+ std::to_string(width) + ", "
+						+ w2xc::getCpuFeatureLevelName(level);
+				passed &= report(name, getMaxError(reference, output),
+						kernelTolerance);
+			}
+
+			// INT8 kernels on the same quantized input differ only by
+			// rounding of dequantization (see filterRow3x3Int8())
+			layer->setInt8Quantization(w2xc::ActivationRange { 0.0f, 1.0f });
+			w2xc::setCpuFeatureLevel(w2xc::CpuFeatureLevel::Scalar);
+			layer->filter(input, reference, nullptr);
+			for (auto&& level : levels) {
+				w2xc::setCpuFeatureLevel(level);
+				w2xc::ActivationTensor output;
+				layer->filter(input, output, nullptr);
+
+				std::string name = "INT8 " + std::to_string(nInputPlanes)
+						+ "->" + std::to_string(nOutputPlanes) + ", width "
+						+ std::to_string(width) + ", "
+						+ w2xc::getCpuFeatureLevelName(level);
+				passed &= report(name, getMaxError(reference, output),
+						kernelTolerance);
+			}
+			layer->clearInt8Quantization();
+		}
+	}
+
+	return passed;
+}
+
+// filterUpsampled2x() against filter() on region of padded upscaled plane
+// (see Model::filterUpsampled2x())
+static bool compareUpsampled(
+		const std::vector<w2xc::CpuFeatureLevel> &levels) {
+	const cv::Size inputSizes[] = { cv::Size(7, 5), cv::Size(13, 9) };
+	const int paddings[] = { 1, 7 };
+	std::unique_ptr<w2xc::Model> layer = makeRandomLayer(1, 32);
+	bool passed = true;
+
+	for (cv::Size inputSize : inputSizes) {
+		cv::Mat input = makeRandomPlane(inputSize);
+		cv::Mat upscaled;
+		cv::resize(input, upscaled, cv::Size(inputSize.width * 2,
+				inputSize.height * 2), 0, 0, cv::INTER_NEAREST);
+
+		for (int padding : paddings) {
+			cv::Mat padded;
+			cv::copyMakeBorder(upscaled, padded, padding, padding, padding,
+					padding, cv::BORDER_REPLICATE);
+			// whole plane, corners and an odd region inside
+			const cv::Rect regions[] = {
+				cv::Rect(0, 0, padded.cols, padded.rows),
+				cv::Rect(0, 0, 5, 7),
+				cv::Rect(padded.cols - 6, padded.rows - 3, 6, 3),
+				cv::Rect(3, 1, 9, 11)
+			};
+
+			for (cv::Rect region : regions) {
+				w2xc::ActivationTensor regionInput =
+						w2xc::ActivationTensor::fromPlane(padded(region));
+
+				for (auto&& level : levels) {
+					w2xc::setCpuFeatureLevel(level);
+					w2xc::ActivationTensor reference, output;
+					layer->filter(regionInput, reference, nullptr);
+					layer->filterUpsampled2x(input, padding, region, output,
+							nullptr);
+
+					std::string name = "upsampled "
+							+ std::to_string(inputSize.width) + "x"
+							+ std::to_string(inputSize.height) + ", padding "
+							+ std::to_string(padding) + ", region at "
+							+ std::to_string(region.x) + ","
+							+ std::to_string(region.y) + ", "
+							+ w2xc::getCpuFeatureLevelName(level);
+					passed &= report(name, getMaxError(reference, output),
+							kernelTolerance);
+				}
+			}
+		}
+	}
+
+	return passed;
+}
+
+// whole model in INT8 mode and with half activations against float
+static bool compareModes(const std::vector<w2xc::CpuFeatureLevel> &levels,
+		const std::string &calibrationFileName) {
+	std::vector<std::unique_ptr<w2xc::Model> > models;
+	for (int index = 0; index < nModelLayers; index++) {
+		models.push_back(makeRandomLayer(modelPlanes[index],
+				modelPlanes[index + 1]));
+	}
+	cv::Mat input = makeRandomPlane(cv::Size(70, 44));
+	bool passed = true;
+
+	// calibration over the input (as calibrateInt8)
+	std::vector<w2xc::ActivationRange> ranges;
+	w2xc::ActivationTensor layerInput = w2xc::ActivationTensor::fromPlane(
+			input);
+	for (auto&& model : models) {
+		std::vector<cv::Mat> planes;
+		layerInput.toPlanes(planes);
+		w2xc::ActivationRange range { std::numeric_limits<float>::max(),
+				std::numeric_limits<float>::lowest() };
+		for (auto&& plane : planes) {
+			double minValue, maxValue;
+			cv::minMaxLoc(plane, &minValue, &maxValue);
+			range.min = std::min(range.min, static_cast<float>(minValue));
+			range.max = std::max(range.max, static_cast<float>(maxValue));
+		}
+		ranges.push_back(range);
+		w2xc::ActivationTensor layerOutput;
+		model->filter(layerInput, layerOutput);
+		layerInput = layerOutput;
+	}
+	if (!w2xc::modelUtility::saveInt8Calibration(calibrationFileName,
+			ranges))
+		return false;
+
+	w2xc::ExecutionContext floatContext =
+			w2xc::modelUtility::getInstance().getExecutionContext();
+	floatContext.halfActivations = false;
+	floatContext.verbose = false;
+	w2xc::ExecutionContext halfContext = floatContext;
+	halfContext.halfActivations = true;
+
+	for (auto&& level : levels) {
+		w2xc::setCpuFeatureLevel(level);
+		std::string levelName = w2xc::getCpuFeatureLevelName(level);
+
+		cv::Mat floatOutput, halfOutput, int8Output;
+		for (auto&& model : models) {
+			model->clearInt8Quantization();
+		}
+		w2xc::convertWithModels(input, floatOutput, models, floatContext,
+				false);
+		w2xc::convertWithModels(input, halfOutput, models, halfContext,
+				false);
+		passed &= report("half activations, " + levelName,
+				getMaxError(floatOutput, halfOutput), halfTolerance);
+
+		if (!w2xc::modelUtility::loadInt8Calibration(calibrationFileName,
+				models))
+			return false;
+		w2xc::convertWithModels(input, int8Output, models, floatContext,
+				false);
+		passed &= report("INT8, " + levelName,
+				getMaxError(floatOutput, int8Output), int8Tolerance);
+	}
+
+	std::remove(calibrationFileName.c_str());
+	return passed;
+}
+
+int main() {
+
+	std::vector<w2xc::CpuFeatureLevel> levels = getSupportedLevels();
+
+	bool passed = compareLayers(levels);
+	passed &= compareUpsampled(levels);
+	passed &= compareModes(levels, "compareKernels.int8.json");
+
+	w2xc::setCpuFeatureLevel(w2xc::detectCpuFeatureLevel());
+	if (!passed) {
+		std::cerr << "Error : some comparisons exceed their bounds"
+				<< std::endl;
+		std::exit(-1);
+	}
+	std::cout << "all comparisons are within their bounds" << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * convertModel.cpp
+ *   converter of JSON model to binary model (separate executable)
+ *
+ *   Binary model (see modelFormat.hpp) is written next to JSON model
+ *   (see modelUtility::getBinaryModelFileName()), where waifu2x-converter
+ *   finds it and reads it instead of parsing JSON. It keeps the hash of
+ *   JSON model, so it is not used after JSON model is changed (until it is
+ *   converted again).
+ *
+ *   usage : convertModel models/noise1_model.json models/scale2.0x_model.json
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "tclap/CmdLine.h"
+
+#include "modelHandler.hpp"
+#include "modelFormat.hpp"
+#include "jsonModelReader.hpp"
+
+// layers of JSON model, read by streaming reader
+static bool readLayers(const std::string &fileName,
+		std::vector<w2xc::JSONModelLayer> &layers) {
+
+	std::ifstream jsonFile(fileName, std::ios::binary);
+	if (!jsonFile.is_open()) {
+		std::cerr << "Error : couldn't open " << fileName << std::endl;
+		return false;
+	}
+
+	std::string errMsg;
+	if (!w2xc::readJSONModel(jsonFile,
+			[&](const w2xc::JSONModelLayer &layer) {
+				layers.push_back(layer);
+				return true;
+			}, errMsg)) {
+		std::cerr << "Error : " << fileName << " : " << errMsg << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv) {
+
+	TCLAP::CmdLine cmd("converter of waifu2x JSON model to binary model", ' ',
+			"1.0.0");
+
+	TCLAP::UnlabeledMultiArg<std::string> cmdModelFiles("models",
+			"model files (JSON)", true, "string", cmd);
+
+	try {
+		cmd.parse(argc, argv);
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		std::cerr << "Error : cmd.parse() threw exception" << std::endl;
+		std::exit(-1);
+	}
+
+	for (auto&& modelFileName : cmdModelFiles.getValue()) {
+		std::vector<w2xc::JSONModelLayer> layers;
+		if (!readLayers(modelFileName, layers))
+			std::exit(-1);
+
+		std::vector<w2xc::BinaryLayer> binaryLayers;
+		for (auto&& layer : layers) {
+			binaryLayers.push_back(w2xc::BinaryLayer { layer.nInputPlanes,
+					layer.nOutputPlanes, layer.kernelSize,
+					layer.weights.data(), layer.biases.data() });
+		}
+
+		uint64_t sourceHash;
+		if (!w2xc::getFileHash(modelFileName, sourceHash)) {
+			std::cerr << "Error : couldn't read " << modelFileName
+					<< std::endl;
+			std::exit(-1);
+		}
+
+		std::string binaryFileName =
+				w2xc::modelUtility::getBinaryModelFileName(modelFileName);
+		if (!w2xc::writeBinaryModel(binaryFileName, binaryLayers,
+				sourceHash))
+			std::exit(-1);
+
+		// read back through the same path as waifu2x-converter
+		std::vector<std::unique_ptr<w2xc::Model> > models;
+		if (!w2xc::modelUtility::generateModelFromBinary(binaryFileName,
+				sourceHash, models))
+			std::exit(-1);
+		std::cout << modelFileName << " -> " << binaryFileName << " ("
+				<< models.size() << " layers)" << std::endl;
+	}
+
+	return 0;
+}
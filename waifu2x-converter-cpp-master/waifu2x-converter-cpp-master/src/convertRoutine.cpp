@@ -9,24 +9,74 @@
  */
 
 #include "convertRoutine.hpp"
+#include "errorReport.hpp"
+#include <atomic>
+#include <functional>
 
 namespace w2xc {
 
+// input tensor of a block of padded input plane (rect in padded plane),
+// with the index of the first layer which is still to be run on it
+typedef std::function<bool(cv::Rect, ActivationTensor &, int &)>
+		BlockInputFunction;
+
 // converting process inside program
-static bool convertWithModelsBasic(cv::Mat &inputPlane, cv::Mat &outputPlane,
-		std::vector<std::unique_ptr<Model> > &models);
+static bool convertWithModelsBasic(ActivationTensor &input,
+		ActivationTensor &output, std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context, int firstLayer = 0);
 static bool convertWithModelsBlockSplit(cv::Mat &inputPlane,
-		cv::Mat &outputPlane, std::vector<std::unique_ptr<Model> > &models);
+		cv::Mat &outputPlane, std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context);
+static bool convertBlocks(cv::Size outputSize,
+		const BlockInputFunction &blockInput, cv::Mat &outputPlane,
+		std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context);
+static bool filterUpsampled2x(cv::Mat &inputPlane, cv::Rect region,
+		ActivationTensor &output,
+		std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context);
+static bool convertWithModelsTileFusion(cv::Mat &inputPlane,
+		cv::Mat &outputPlane, std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context);
+static bool convertWithModelsStreaming(cv::Mat &inputPlane,
+		cv::Mat &outputPlane, std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context);
+
+// precision of planes kept between layers in basic execution
+// (Model::filter() allocates output in the precision of input)
+static ActivationPrecision getActivationPrecision(
+		const ExecutionContext &context) {
+	return context.halfActivations ?
+			ActivationPrecision::Half : ActivationPrecision::Float;
+}
 
 bool convertWithModels(cv::Mat &inputPlane, cv::Mat &outputPlane,
 		std::vector<std::unique_ptr<Model> > &models, bool blockSplitting) {
+	return convertWithModels(inputPlane, outputPlane, models,
+			modelUtility::getInstance().getExecutionContext(),
+			blockSplitting);
+}
+
+bool convertWithModels(cv::Mat &inputPlane, cv::Mat &outputPlane,
+		std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context, bool blockSplitting) {
+
+	if (context.streaming) {
+		return convertWithModelsStreaming(inputPlane, outputPlane, models,
+				context);
+	}
+	if (context.tileFusion) {
+		return convertWithModelsTileFusion(inputPlane, outputPlane, models,
+				context);
+	}
 
-	cv::Size blockSize = modelUtility::getInstance().getBlockSize();
+	cv::Size blockSize = context.blockSize;
 	bool requireSplitting = (inputPlane.size().width * inputPlane.size().height)
 			> blockSize.width * blockSize.height * 3 / 2;
 //	requireSplitting = true;
 	if (blockSplitting && requireSplitting) {
-		return convertWithModelsBlockSplit(inputPlane, outputPlane, models);
+		return convertWithModelsBlockSplit(inputPlane, outputPlane, models,
+				context);
 	} else {
 		//insert padding to inputPlane
 		cv::Mat tempMat;
@@ -35,67 +85,146 @@ bool convertWithModels(cv::Mat &inputPlane, cv::Mat &outputPlane,
 		cv::copyMakeBorder(inputPlane, tempMat, nModel, nModel, nModel, nModel,
 				cv::BORDER_REPLICATE);
 
-		bool ret = convertWithModelsBasic(tempMat, outputPlane, models);
-
-		tempMat = outputPlane(cv::Range(nModel, outputSize.height + nModel),
-				cv::Range(nModel, outputSize.width + nModel));
-		assert(
-				tempMat.size().width == outputSize.width
-						&& tempMat.size().height == outputSize.height);
+		ActivationTensor input = ActivationTensor::fromPlane(tempMat,
+				getActivationPrecision(context));
+		ActivationTensor output;
+		bool ret = convertWithModelsBasic(input, output, models, context);
 
-		tempMat.copyTo(outputPlane);
+		output.roi(cv::Rect(nModel, nModel, outputSize.width,
+				outputSize.height)).toPlane(0, outputPlane);
 
 		return ret;
 	}
 
 }
 
-static bool convertWithModelsBasic(cv::Mat &inputPlane, cv::Mat &outputPlane,
-		std::vector<std::unique_ptr<Model> > &models) {
+// first layer on region of padded 2x upscaled plane, in the precision of
+// context (the upscaled plane is not made)
+static bool filterUpsampled2x(cv::Mat &inputPlane, cv::Rect region,
+		ActivationTensor &output,
+		std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context) {
+	ActivationTensor firstOutput;
+	if (!models[0]->filterUpsampled2x(inputPlane, models.size(), region,
+			firstOutput, context.threadPool)) {
+		return false;
+	}
+	if (getActivationPrecision(context) == ActivationPrecision::Float) {
+		output = firstOutput;
+	} else {
+		output = ActivationTensor(firstOutput.getNChannels(),
+				firstOutput.size(), getActivationPrecision(context));
+		ActivationTensor::convertRows(firstOutput, -ActivationTensor::halo,
+				output, -ActivationTensor::halo,
+				firstOutput.size().height + 2 * ActivationTensor::halo);
+	}
+	return true;
+}
+
+bool convertWithModelsUpsampled2x(cv::Mat &inputPlane, cv::Mat &outputPlane,
+		std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context) {
 
-	// padding is require before calling this function
+	cv::Size outputSize(inputPlane.size().width * 2,
+			inputPlane.size().height * 2);
+
+	// depth-first executions take the upscaled plane
+	if (context.streaming || context.tileFusion || models.size() < 2
+			|| !models[0]->canFilterUpsampled2x()) {
+		cv::Mat upscaledPlane;
+		cv::resize(inputPlane, upscaledPlane, outputSize, 0, 0,
+				cv::INTER_NEAREST);
+		return convertWithModels(upscaledPlane, outputPlane, models, context);
+	}
 
-	std::unique_ptr<std::vector<cv::Mat> > inputPlanes = std::unique_ptr<
-			std::vector<cv::Mat> >(new std::vector<cv::Mat>());
-	std::unique_ptr<std::vector<cv::Mat> > outputPlanes = std::unique_ptr<
-			std::vector<cv::Mat> >(new std::vector<cv::Mat>());
+	int nModel = models.size();
+	cv::Size blockSize = context.blockSize;
+	bool requireSplitting = (outputSize.width * outputSize.height)
+			> blockSize.width * blockSize.height * 3 / 2;
+	if (requireSplitting) {
+		return convertBlocks(outputSize,
+				[&](cv::Rect blockRect, ActivationTensor &blockInput,
+						int &firstLayer) {
+					firstLayer = 1;
+					return filterUpsampled2x(inputPlane, blockRect,
+							blockInput, models, context);
+				}, outputPlane, models, context);
+	}
+
+	ActivationTensor input;
+	ActivationTensor output;
+	if (!filterUpsampled2x(inputPlane,
+			cv::Rect(0, 0, outputSize.width + 2 * nModel,
+					outputSize.height + 2 * nModel), input, models, context)
+			|| !convertWithModelsBasic(input, output, models, context, 1)) {
+		return false;
+	}
 
-	inputPlanes->clear();
-	inputPlanes->push_back(inputPlane);
+	output.roi(cv::Rect(nModel, nModel, outputSize.width,
+			outputSize.height)).toPlane(0, outputPlane);
+	return true;
 
-	for (int index = 0; index < models.size(); index++) {
-		std::cout << "Iteration #" << (index + 1) << "..." << std::endl;
-		if (!models[index]->filter(*inputPlanes, *outputPlanes)) {
-			std::exit(-1);
+}
+
+static bool convertWithModelsBasic(ActivationTensor &input,
+		ActivationTensor &output, std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context, int firstLayer) {
+
+	// padding is require before calling this function
+	// (layers before firstLayer have been run on input)
+
+	// tensor of previous layer is released when it is replaced
+	ActivationTensor inputPlanes = input;
+
+	for (std::size_t index = firstLayer; index < models.size(); index++) {
+		if (context.verbose)
+			std::cout << "Iteration #" << (index + 1) << "..." << std::endl;
+		if (!models[index]->filter(inputPlanes, output, context.threadPool)) {
+			return false;
 		}
 		if (index != models.size() - 1) {
-			inputPlanes = std::move(outputPlanes);
-			outputPlanes = std::unique_ptr<std::vector<cv::Mat> >(
-					new std::vector<cv::Mat>());
+			inputPlanes = output;
 		}
 	}
 
-	outputPlanes->at(0).copyTo(outputPlane);
-
 	return true;
 
 }
 
 static bool convertWithModelsBlockSplit(cv::Mat &inputPlane,
-		cv::Mat &outputPlane, std::vector<std::unique_ptr<Model> > &models) {
+		cv::Mat &outputPlane, std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context) {
 
 	// padding is not required before calling this function
 
-	// initialize local variables
-	cv::Size blockSize = modelUtility::getInstance().getBlockSize();
-	unsigned int nModel = models.size();
-
 	//insert padding to inputPlane
 	cv::Mat tempMat;
-	cv::Size outputSize = inputPlane.size();
+	int nModel = models.size();
 	cv::copyMakeBorder(inputPlane, tempMat, nModel, nModel, nModel, nModel,
 			cv::BORDER_REPLICATE);
 
+	return convertBlocks(inputPlane.size(),
+			[&](cv::Rect blockRect, ActivationTensor &blockInput,
+					int &firstLayer) {
+				blockInput = ActivationTensor::fromPlane(tempMat(blockRect),
+						getActivationPrecision(context));
+				firstLayer = 0;
+				return true;
+			}, outputPlane, models, context);
+
+}
+
+static bool convertBlocks(cv::Size outputSize,
+		const BlockInputFunction &blockInput, cv::Mat &outputPlane,
+		std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context) {
+
+	// initialize local variables
+	cv::Size blockSize = context.blockSize;
+	unsigned int nModel = models.size();
+	cv::Size paddedSize(outputSize.width + 2 * nModel,
+			outputSize.height + 2 * nModel);
+
 	// calcurate split rows/cols
 	unsigned int splitColumns = static_cast<unsigned int>(std::ceil(
 			static_cast<float>(outputSize.width)
@@ -105,68 +234,307 @@ static bool convertWithModelsBlockSplit(cv::Mat &inputPlane,
 					/ static_cast<float>(blockSize.height - 2 * nModel)));
 
 	// start to convert
-	cv::Mat processRow;
-	cv::Mat processBlock;
-	cv::Mat processBlockOutput;
-	cv::Mat writeMatTo;
-	cv::Mat writeMatFrom;
+	// blocks are issued to the thread pool, and each block is divided further
+	// in Model::filter() on the same pool.
+	// number of blocks in flight is limited, since intermediate planes of
+	// one block take hundreds of MB.
+	constexpr int maxBlocksInFlight = 2;
+	std::atomic<bool> succeeded(true);
 	outputPlane = cv::Mat::zeros(outputSize, CV_32FC1);
-	for (unsigned int r = 0; r < splitRows; r++) {
-		if (r == splitRows - 1) {
-			processRow = tempMat.rowRange(r * (blockSize.height - 2 * nModel),
-					tempMat.size().height);
-		} else {
-			processRow = tempMat.rowRange(r * (blockSize.height - 2 * nModel),
-					r * (blockSize.height - 2 * nModel) + blockSize.height);
+	context.threadPool->parallelFor(
+			splitRows * splitColumns, [&](int blockIndex) {
+		unsigned int r = blockIndex / splitColumns;
+		unsigned int c = blockIndex % splitColumns;
+		ActivationTensor processBlockInput;
+		ActivationTensor processBlockOutput;
+		cv::Mat writeMatTo;
+
+		// region of the block in padded input plane
+		int top = r * (blockSize.height - 2 * nModel);
+		int bottom = (r == splitRows - 1) ?
+				paddedSize.height : top + blockSize.height;
+		int left = c * (blockSize.width - 2 * nModel);
+		int right = (c == splitColumns - 1) ?
+				paddedSize.width : left + blockSize.width;
+		cv::Rect blockRect(left, top, right - left, bottom - top);
+
+		if (context.verbose) {
+			std::cout << "start process block (" << c << "," << r << ") ..."
+					<< std::endl;
+		}
+		int firstLayer = 0;
+		if (!blockInput(blockRect, processBlockInput, firstLayer)
+				|| !convertWithModelsBasic(processBlockInput,
+						processBlockOutput, models, context, firstLayer)) {
+			succeeded = false;
+			return;
 		}
-		for (unsigned int c = 0; c < splitColumns; c++) {
-			if (c == splitColumns - 1) {
-				processBlock = processRow.colRange(
-						c * (blockSize.width - 2 * nModel),
-						tempMat.size().width);
-			} else {
-				processBlock = processRow.colRange(
-						c * (blockSize.width - 2 * nModel),
-						c * (blockSize.width - 2 * nModel) + blockSize.width);
+
+		cv::Rect writeRectFrom(nModel, nModel,
+				processBlockOutput.size().width - 2 * nModel,
+				processBlockOutput.size().height - 2 * nModel);
+		// (output plane is not padded, so the block is written at the
+		// position of the block in padded input plane)
+		writeMatTo = outputPlane(
+				cv::Range(top, top + writeRectFrom.height),
+				cv::Range(left, left + writeRectFrom.width));
+		assert(writeMatTo.size() == writeRectFrom.size());
+		// writeMatTo has the same size, so written in place
+		processBlockOutput.roi(writeRectFrom).toPlane(0, writeMatTo);
+
+	}, maxBlocksInFlight); // end process all blocks
+
+	// (reported on calling thread, blocks run on workers of the pool)
+	if (!succeeded) {
+		reportError("w2xc::convertWithModelsBasic() "
+				"in w2xc::convertWithModelsBlockSplit() : "
+				"something error has occured. stop.");
+	}
+	return succeeded;
+
+}
+
+// working set of one tile in depth-first execution (about the size of L2)
+static constexpr int tileFusionCacheBudget = 1 << 20;
+static constexpr int tileFusionMinimumSize = 8;
+
+static bool convertWithModelsTileFusion(cv::Mat &inputPlane,
+		cv::Mat &outputPlane, std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context) {
+
+	// padding is not required before calling this function
+
+	// depth-first execution :
+	// a small tile is pushed through all layers on one thread before the next
+	// tile starts, so intermediate planes of the tile stay in cache.
+	// each layer shrinks the tile by 1 pixel at sides which are inside of the
+	// padded plane (those pixels have used halo of the tile), so only the
+	// thin halo of nModel pixels is recomputed by adjacent tiles.
+
+	int nModel = models.size();
+
+	// edge length of output tile
+	int tileSize = context.tileFusionSize;
+	if (tileSize == 0) {
+		int maxPlanes = 0;
+		for (auto&& model : models) {
+			maxPlanes = std::max(maxPlanes,
+					model->getNInputPlanes() + model->getNOutputPlanes());
+		}
+		int tileWithHalo = static_cast<int>(std::sqrt(
+				static_cast<double>(tileFusionCacheBudget)
+						/ (sizeof(float) * maxPlanes)));
+		tileSize = std::max(tileWithHalo - 2 * nModel, tileFusionMinimumSize);
+	}
+
+	//insert padding to inputPlane
+	cv::Mat tempMat;
+	cv::Size outputSize = inputPlane.size();
+	cv::copyMakeBorder(inputPlane, tempMat, nModel, nModel, nModel, nModel,
+			cv::BORDER_REPLICATE);
+
+	ActivationTensor paddedInput = ActivationTensor::fromPlane(tempMat);
+
+	int splitColumns = (outputSize.width + tileSize - 1) / tileSize;
+	int splitRows = (outputSize.height + tileSize - 1) / tileSize;
+
+	std::atomic<bool> succeeded(true);
+	outputPlane = cv::Mat(outputSize, CV_32FC1);
+	context.threadPool->parallelFor(
+			splitRows * splitColumns, [&](int tileIndex) {
+		int r = tileIndex / splitColumns;
+		int c = tileIndex % splitColumns;
+		cv::Rect outputRect(c * tileSize, r * tileSize,
+				std::min(tileSize, outputSize.width - c * tileSize),
+				std::min(tileSize, outputSize.height - r * tileSize));
+
+		// region of this tile in padded plane
+		cv::Rect region(outputRect.x, outputRect.y,
+				outputRect.width + 2 * nModel, outputRect.height + 2 * nModel);
+
+		ActivationTensor inputPlanes = paddedInput.roi(region);
+		ActivationTensor outputPlanes;
+
+		for (int index = 0; index < nModel; index++) {
+			if (!models[index]->filter(inputPlanes, outputPlanes, nullptr)) {
+				succeeded = false;
+				return;
 			}
 
-			std::cout << "start process block (" << c << "," << r << ") ..."
-					<< std::endl;
-			if (!convertWithModelsBasic(processBlock, processBlockOutput,
-					models)) {
-				std::cerr << "w2xc::convertWithModelsBasic()\n"
-						"in w2xc::convertWithModelsBlockSplit() : \n"
-						"something error has occured. stop." << std::endl;
+			int left = (region.x > 0) ? 1 : 0;
+			int top = (region.y > 0) ? 1 : 0;
+			int right = (region.x + region.width < tempMat.cols) ? 1 : 0;
+			int bottom = (region.y + region.height < tempMat.rows) ? 1 : 0;
+			cv::Rect validRect(left, top, region.width - left - right,
+					region.height - top - bottom);
+			region.x += left;
+			region.y += top;
+			region.width = validRect.width;
+			region.height = validRect.height;
+
+			inputPlanes = outputPlanes.roi(validRect);
+		}
+
+		// outputRect is at (+nModel, +nModel) in padded plane
+		cv::Rect resultRect(outputRect.x + nModel - region.x,
+				outputRect.y + nModel - region.y, outputRect.width,
+				outputRect.height);
+		cv::Mat writeMatTo = outputPlane(outputRect);
+		inputPlanes.roi(resultRect).toPlane(0, writeMatTo);
+	});
+
+	return succeeded;
+
+}
+
+static bool convertWithModelsStreaming(cv::Mat &inputPlane,
+		cv::Mat &outputPlane, std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context) {
+
+	// padding is not required before calling this function
+
+	// streaming execution :
+	// each layer keeps a ring buffer of a few rows of its input planes, and
+	// emits output rows to next layer as soon as 3 input rows are ready.
+	// peak memory depends on (width x total planes), not on image area.
+	// result is identical to processing whole padded plane at once.
+
+	int nModel = models.size();
+	for (auto&& model : models) {
+		if (model->getKernelSize() != 3) {
+			// rows can be streamed only through 3x3 layers
+			return convertWithModelsBlockSplit(inputPlane, outputPlane, models,
+					context);
+		}
+	}
+
+	cv::Size outputSize = inputPlane.size();
+	int width = outputSize.width + 2 * nModel; // padded width
+	int height = outputSize.height + 2 * nModel; // padded height
+
+	// rows are in channel-blocked layout of ActivationTensor, with 1 pixel of
+	// replicated halo at both ends of each block
+	constexpr int C = tensorChannelBlock;
+	int blockRowFloats = (width + 2) * C;
+
+	// rows produced at once by a layer (tasks are output blocks x rows),
+	// ring buffer also holds upper and lower neighbour rows
+	int batchRows = context.threadPool->getNumberOfThreads();
+	int ringRows = batchRows + 2;
+
+	std::vector<int> inputBlocks(nModel);
+	std::vector<int> outputBlocks(nModel);
+	std::vector<std::vector<float> > rings(nModel);
+	std::vector<std::vector<float> > layerOutputs(nModel);
+	std::vector<int> receivedRows(nModel, 0);
+	std::vector<int> producedRows(nModel, 0);
+	for (int index = 0; index < nModel; index++) {
+		inputBlocks[index] = (models[index]->getNInputPlanes() + C - 1) / C;
+		outputBlocks[index] = (models[index]->getNOutputPlanes() + C - 1) / C;
+		rings[index].resize(ringRows * inputBlocks[index] * blockRowFloats);
+		layerOutputs[index].resize(
+				batchRows * outputBlocks[index] * blockRowFloats);
+	}
+
+	outputPlane = cv::Mat(outputSize, CV_32FC1);
+
+	// push one row (all input blocks with halo, blocks are contiguous) to
+	// a layer, and propagate rows which have become computable
+	std::function<bool(int, const float *)> pushRow = [&](int index,
+			const float *row) -> bool {
+		int nInBlocks = inputBlocks[index];
+		int nOutBlocks = outputBlocks[index];
+		float *ring = rings[index].data();
+
+		std::copy(row, row + nInBlocks * blockRowFloats,
+				ring + (receivedRows[index] % ringRows) * nInBlocks
+						* blockRowFloats);
+		receivedRows[index]++;
+
+		while (producedRows[index] < height) {
+			int y0 = producedRows[index];
+			int nRows = std::min(batchRows, height - y0);
+			// lower neighbour of last row is needed (replicated at bottom)
+			if (receivedRows[index] < std::min(y0 + nRows + 1, height))
+				break;
+
+			std::vector<const float *> inputRows(nRows * nInBlocks * 3);
+			std::vector<float *> outputRows(nRows * nOutBlocks);
+			for (int r = 0; r < nRows; r++) {
+				int y = y0 + r;
+				int ys[3] = { std::max(y - 1, 0), y, std::min(y + 1, height - 1) };
+				for (int ipBlock = 0; ipBlock < nInBlocks; ipBlock++) {
+					for (int k = 0; k < 3; k++) {
+						inputRows[(r * nInBlocks + ipBlock) * 3 + k] = ring
+								+ ((ys[k] % ringRows) * nInBlocks + ipBlock)
+										* blockRowFloats + C;
+					}
+				}
+				for (int opBlock = 0; opBlock < nOutBlocks; opBlock++) {
+					outputRows[r * nOutBlocks + opBlock] =
+							layerOutputs[index].data()
+									+ (r * nOutBlocks + opBlock)
+											* blockRowFloats + C;
+				}
+			}
+
+			if (!models[index]->filterRows(inputRows.data(),
+					outputRows.data(), nRows, width, context.threadPool)) {
 				return false;
 			}
+			producedRows[index] += nRows;
+
+			for (int r = 0; r < nRows; r++) {
+				// replicate halo pixels of output rows
+				for (int opBlock = 0; opBlock < nOutBlocks; opBlock++) {
+					float *blockRow = outputRows[r * nOutBlocks + opBlock];
+					std::copy(blockRow, blockRow + C, blockRow - C);
+					std::copy(blockRow + (width - 1) * C, blockRow + width * C,
+							blockRow + width * C);
+				}
+
+				const float *outputRow = layerOutputs[index].data()
+						+ r * nOutBlocks * blockRowFloats;
+				if (index + 1 < nModel) {
+					if (!pushRow(index + 1, outputRow))
+						return false;
+				} else {
+					// last layer : crop padding (channel 0 of block 0)
+					int y = y0 + r - nModel;
+					if (y >= 0 && y < outputSize.height) {
+						float *dst = outputPlane.ptr<float>(y);
+						for (int x = 0; x < outputSize.width; x++) {
+							dst[x] = outputRow[(x + nModel + 1) * C];
+						}
+					}
+				}
+			}
+		}
 
-			writeMatFrom = processBlockOutput(
-					cv::Range(nModel,
-							processBlockOutput.size().height - nModel),
-					cv::Range(nModel,
-							processBlockOutput.size().width - nModel));
-			writeMatTo = outputPlane(
-					cv::Range(r * (blockSize.height - 2 * nModel),
-							r * (blockSize.height - 2 * nModel)
-									+ processBlockOutput.size().height
-									- 2 * nModel),
-					cv::Range(c * (blockSize.height - 2 * nModel),
-							c * (blockSize.height - 2 * nModel)
-									+ processBlockOutput.size().width
-									- 2 * nModel));
-			assert(
-					writeMatTo.size().height == writeMatFrom.size().height
-							&& writeMatTo.size().width
-									== writeMatFrom.size().width);
-			writeMatFrom.copyTo(writeMatTo);
-
-		} // end process 1 column
-
-	} // end process all blocks
+		return true;
+	};
+
+	// feed input rows with replicated padding
+	// (single input plane, as channel 0 of one block)
+	std::vector<float> paddedRow(blockRowFloats, 0.0f);
+	for (int y = 0; y < height; y++) {
+		int inputY = std::min(std::max(y - nModel, 0), outputSize.height - 1);
+		const float *inputRow = inputPlane.ptr<float>(inputY);
+		for (int x = -1; x <= width; x++) {
+			int inputX = std::min(std::max(x - nModel, 0),
+					outputSize.width - 1);
+			paddedRow[(x + 1) * C] = inputRow[inputX];
+		}
+
+		if (!pushRow(0, paddedRow.data())) {
+			reportError("w2xc::convertWithModelsStreaming() : "
+					"something error has occured. stop.");
+			return false;
+		}
+	}
 
 	return true;
 
 }
 
 }
-
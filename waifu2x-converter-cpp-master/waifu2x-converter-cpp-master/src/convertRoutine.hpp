@@ -21,11 +21,28 @@ namespace w2xc {
 
 /**
  * convert inputPlane to outputPlane by convoluting with models.
+ * (with execution context of modelUtility, or given one)
  */
 bool convertWithModels(cv::Mat &inputPlanes,
 		cv::Mat &outputPlanes,
 		std::vector<std::unique_ptr<Model> > &models,
 		bool blockSplitting = true);
+bool convertWithModels(cv::Mat &inputPlanes,
+		cv::Mat &outputPlanes,
+		std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context,
+		bool blockSplitting = true);
+
+/**
+ * convertWithModels() on nearest-neighbour 2x upscaled inputPlane.
+ * first layer reads inputPlane directly (see Model::filterUpsampled2x()),
+ * so the upscaled plane is made only in tile fusion and streaming
+ * execution.
+ */
+bool convertWithModelsUpsampled2x(cv::Mat &inputPlane,
+		cv::Mat &outputPlane,
+		std::vector<std::unique_ptr<Model> > &models,
+		const ExecutionContext &context);
 
 }
 
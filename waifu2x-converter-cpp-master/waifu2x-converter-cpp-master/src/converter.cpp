@@ -0,0 +1,171 @@
+/*
+ * converter.cpp
+ *   re-entrant converter for applications embedding waifu2x
+ */
+
+#include "converter.hpp"
+#include "autotune.hpp"
+#include "errorReport.hpp"
+#include <algorithm>
+
+namespace w2xc {
+
+// errors of lower functions are collected (nothing goes to std::cerr)
+// and appended to message
+static std::string getErrorMessage(const std::string &message,
+		const ErrorCollector &errors) {
+	if (errors.empty())
+		return message;
+	return message + " (" + errors.getMessage() + ")";
+}
+
+Converter::Converter(int nThreads) :
+		threadPool(std::max(nThreads, 1)) {
+	context.threadPool = &threadPool;
+	context.blockSize = cv::Size(512, 512);
+	context.tileFusion = false;
+	context.tileFusionSize = 0;
+	context.streaming = false;
+	context.halfActivations = false;
+	context.verbose = false;
+}
+
+bool Converter::setBlockSize(cv::Size size) {
+	if (size.width < 0 || size.height < 0)
+		return false;
+	context.blockSize = size;
+	return true;
+}
+
+bool Converter::setTileFusion(bool enable, int tileSize) {
+	if (tileSize < 0)
+		return false;
+	context.tileFusion = enable;
+	context.tileFusionSize = tileSize;
+	return true;
+}
+
+void Converter::setStreaming(bool enable) {
+	context.streaming = enable;
+}
+
+void Converter::setHalfActivations(bool enable) {
+	context.halfActivations = enable;
+}
+
+bool Converter::loadModelFile(const std::string &modelFileName,
+		const std::string &tuningCacheFileName,
+		std::vector<std::unique_ptr<Model> > &layers, cv::Size &blockSize,
+		std::string &errorMessage) {
+
+	// up-to-date binary model next to JSON model is preferred
+	// (see convertModel.cpp)
+	ErrorCollector errors;
+	std::string fileName = modelFileName;
+	layers.clear();
+	blockSize = cv::Size();
+	if (!modelUtility::generateModel(fileName, layers)) {
+		errorMessage = getErrorMessage("couldn't load " + modelFileName,
+				errors);
+		return false;
+	}
+
+	if (tuningCacheFileName.empty())
+		return true;
+	std::string key = getTuningKey(fileName,
+			threadPool.getNumberOfThreads());
+	ExecutionPlan plan;
+	if (!key.empty()
+			&& loadExecutionPlan(tuningCacheFileName, key, plan)) {
+		if (!applyExecutionPlan(plan, layers)) {
+			errorMessage = "tuned plan in " + tuningCacheFileName
+					+ " doesn't fit " + fileName;
+			return false;
+		}
+		blockSize = plan.blockSize;
+	}
+	return true;
+}
+
+bool Converter::loadModels(const std::string &modelDirectory,
+		const std::string &tuningCacheFileName, std::string &errorMessage) {
+	for (int level = 1; level <= 2; level++) {
+		if (!loadModelFile(
+				modelDirectory + "/noise" + std::to_string(level)
+						+ "_model.json", tuningCacheFileName,
+				models.noise[level - 1], models.noiseBlockSize[level - 1],
+				errorMessage)) {
+			return false;
+		}
+	}
+	return loadModelFile(modelDirectory + "/scale2.0x_model.json",
+			tuningCacheFileName, models.scale, models.scaleBlockSize,
+			errorMessage);
+}
+
+bool Converter::convert(const cv::Mat &input, cv::Mat &output,
+		const ConversionSettings &settings, std::string &errorMessage) {
+	if (input.type() != CV_8UC3) {
+		errorMessage = "input is not 8-bit BGR image";
+		return false;
+	}
+	if (!isValidConversionSettings(settings)) {
+		errorMessage = "invalid mode, noise level or scale ratio";
+		return false;
+	}
+
+	ErrorCollector errors;
+	try {
+		PlanarImage image;
+		toPlanarImage(input, image, &threadPool);
+		if (!convertImage(image, settings, models, context)) {
+			errorMessage = getErrorMessage("conversion failed", errors);
+			return false;
+		}
+		toBGRImage(image, output, &threadPool);
+		if (image.isGray())
+			cv::cvtColor(output, output, cv::COLOR_GRAY2BGR);
+	} catch (std::exception &e) {
+		errorMessage = e.what();
+		return false;
+	}
+	return true;
+}
+
+bool Converter::convertFile(const std::string &inputFileName,
+		const std::string &outputFileName,
+		const ConversionSettings &settings, std::string &errorMessage) {
+	ErrorCollector errors;
+	PlanarImage image;
+	if (!decodeImage(inputFileName, image, &threadPool)) {
+		errorMessage = getErrorMessage("couldn't read " + inputFileName,
+				errors);
+		return false;
+	}
+	if (!isValidConversionSettings(settings)) {
+		errorMessage = "invalid mode, noise level or scale ratio";
+		return false;
+	}
+
+	bool converted;
+	try {
+		converted = convertImage(image, settings, models, context);
+	} catch (std::exception &e) {
+		errorMessage = e.what();
+		return false;
+	}
+	if (!converted) {
+		errorMessage = getErrorMessage(
+				"conversion of " + inputFileName + " failed", errors);
+		return false;
+	}
+
+	if (!encodeImage(image, outputFileName, &threadPool)) {
+		errorMessage = getErrorMessage("couldn't write " + outputFileName,
+				errors);
+		return false;
+	}
+	return true;
+}
+
+}
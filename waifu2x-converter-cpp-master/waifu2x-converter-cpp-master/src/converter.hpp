@@ -0,0 +1,78 @@
+/*
+ * converter.hpp
+ *   re-entrant converter for applications embedding waifu2x
+ *
+ *   A Converter owns its models, thread pool and execution settings
+ *   (modelUtility is not used), reports errors as return values with
+ *   the details in errorMessage (see errorReport.hpp), and prints
+ *   nothing. Models are not modified while converting, so
+ *   one Converter can convert images on many threads at the same time
+ *   (the conversions share its thread pool).
+ *
+ *     w2xc::Converter converter(8);
+ *     std::string errorMessage;
+ *     if (!converter.loadModels("models", "", errorMessage)) ...
+ *     if (!converter.convert(input, output, settings, errorMessage)) ...
+ */
+
+#ifndef CONVERTER_HPP_
+#define CONVERTER_HPP_
+
+#include <string>
+#include "imageConversion.hpp"
+#include "threadPool.hpp"
+
+namespace w2xc {
+
+class Converter {
+
+private:
+	ThreadPool threadPool;
+	ExecutionContext context;
+	ConversionModels models;
+
+	Converter(const Converter &) = delete;
+	Converter &operator=(const Converter &) = delete;
+
+	// blockSize is set to tuned block size of the model (empty if none)
+	bool loadModelFile(const std::string &modelFileName,
+			const std::string &tuningCacheFileName,
+			std::vector<std::unique_ptr<Model> > &layers, cv::Size &blockSize,
+			std::string &errorMessage);
+
+public:
+	// nThreads : number of threads running a conversion
+	//            (calling thread of convert() is one of them)
+	explicit Converter(int nThreads);
+
+	// execution settings (see modelUtility), set before converting
+	bool setBlockSize(cv::Size size);
+	bool setTileFusion(bool enable, int tileSize = 0);
+	void setStreaming(bool enable);
+	void setHalfActivations(bool enable);
+
+	/**
+	 * load models of all modes from modelDirectory (binary model is used
+	 * if it is next to JSON model), and apply tuned plans of them in
+	 * tuningCacheFileName (made by --autotune, empty : no tuned plans).
+	 * tuned block size of a model is used for it instead of setBlockSize().
+	 * must not be called while converting.
+	 */
+	bool loadModels(const std::string &modelDirectory,
+			const std::string &tuningCacheFileName, std::string &errorMessage);
+
+	/**
+	 * convert 8-bit BGR image (CV_8UC3) into output (CV_8UC3).
+	 * can be called from many threads at the same time.
+	 */
+	bool convert(const cv::Mat &input, cv::Mat &output,
+			const ConversionSettings &settings, std::string &errorMessage);
+	bool convertFile(const std::string &inputFileName,
+			const std::string &outputFileName,
+			const ConversionSettings &settings, std::string &errorMessage);
+
+};
+
+}
+
+#endif /* CONVERTER_HPP_ */
@@ -0,0 +1,166 @@
+/*
+ * cpuFeatures.cpp
+ *   SIMD instruction set level used by convolution kernels
+ */
+
+#include "cpuFeatures.hpp"
+#include <atomic>
+#include <cstring>
+
+#ifdef W2XC_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace w2xc {
+
+#ifdef W2XC_X86
+
+static void cpuid(unsigned int leaf, unsigned int subleaf,
+		unsigned int regs[4]) {
+#if defined(_MSC_VER)
+	int r[4];
+	__cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+	for (int i = 0; i < 4; i++) {
+		regs[i] = static_cast<unsigned int>(r[i]);
+	}
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// XCR0 : register states enabled by OS
+static unsigned long long xgetbv0() {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ __volatile__ ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+
+CpuFeatureLevel detectCpuFeatureLevel() {
+	unsigned int regs[4]; // eax, ebx, ecx, edx
+
+	cpuid(0, 0, regs);
+	unsigned int maxLeaf = regs[0];
+	if (maxLeaf < 1)
+		return CpuFeatureLevel::Universal;
+
+	cpuid(1, 0, regs);
+	bool sse41 = (regs[2] & (1u << 19)) != 0;
+	bool fma = (regs[2] & (1u << 12)) != 0;
+	bool osxsave = (regs[2] & (1u << 27)) != 0;
+	bool avx = (regs[2] & (1u << 28)) != 0;
+	bool f16c = (regs[2] & (1u << 29)) != 0;
+	if (!sse41)
+		return CpuFeatureLevel::Universal;
+	if (!(osxsave && avx && fma && f16c) || maxLeaf < 7)
+		return CpuFeatureLevel::SSE41;
+
+	unsigned long long xcr0 = xgetbv0();
+	// XMM and YMM state
+	if ((xcr0 & 0x06) != 0x06)
+		return CpuFeatureLevel::SSE41;
+
+	cpuid(7, 0, regs);
+	bool avx2 = (regs[1] & (1u << 5)) != 0;
+	bool avx512f = (regs[1] & (1u << 16)) != 0;
+	bool avx512vnni = (regs[2] & (1u << 11)) != 0;
+	if (!avx2)
+		return CpuFeatureLevel::SSE41;
+	// opmask, upper ZMM0-15 and ZMM16-31 state
+	if (!avx512f || (xcr0 & 0xe0) != 0xe0)
+		return CpuFeatureLevel::AVX2;
+	if (!avx512vnni)
+		return CpuFeatureLevel::AVX512;
+
+	return CpuFeatureLevel::AVX512VNNI;
+}
+
+std::string getCpuModelName() {
+	unsigned int regs[4];
+	cpuid(0x80000000, 0, regs);
+	if (regs[0] < 0x80000004)
+		return "unknown";
+
+	// brand string : 48 bytes in leaves 0x80000002 - 0x80000004
+	char brand[49] = { };
+	for (int i = 0; i < 3; i++) {
+		cpuid(0x80000002 + i, 0, regs);
+		std::memcpy(brand + i * 16, regs, 16);
+	}
+	std::string name(brand);
+	std::size_t first = name.find_first_not_of(' ');
+	std::size_t last = name.find_last_not_of(' ');
+	if (first == std::string::npos)
+		return "unknown";
+	return name.substr(first, last - first + 1);
+}
+
+#else
+
+CpuFeatureLevel detectCpuFeatureLevel() {
+	return CpuFeatureLevel::Universal;
+}
+
+std::string getCpuModelName() {
+	return "unknown";
+}
+
+#endif
+
+static std::atomic<int> selectedLevel(-1); // -1 : not detected yet
+
+CpuFeatureLevel getCpuFeatureLevel() {
+	int level = selectedLevel.load(std::memory_order_relaxed);
+	if (level < 0) {
+		level = static_cast<int>(detectCpuFeatureLevel());
+		selectedLevel.store(level, std::memory_order_relaxed);
+	}
+	return static_cast<CpuFeatureLevel>(level);
+}
+
+bool setCpuFeatureLevel(CpuFeatureLevel level) {
+	if (level > detectCpuFeatureLevel())
+		return false;
+	selectedLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+	return true;
+}
+
+std::string getCpuFeatureLevelName(CpuFeatureLevel level) {
+	switch (level) {
+	case CpuFeatureLevel::Universal:
+		return "universal";
+	case CpuFeatureLevel::SSE41:
+		return "sse4.1";
+	case CpuFeatureLevel::AVX2:
+		return "avx2";
+	case CpuFeatureLevel::AVX512:
+		return "avx512";
+	case CpuFeatureLevel::AVX512VNNI:
+		return "avx512vnni";
+	default:
+		return "scalar";
+	}
+}
+
+bool parseCpuFeatureLevel(const std::string &name, CpuFeatureLevel &level) {
+	const CpuFeatureLevel levels[] = { CpuFeatureLevel::Scalar,
+			CpuFeatureLevel::Universal, CpuFeatureLevel::SSE41,
+			CpuFeatureLevel::AVX2, CpuFeatureLevel::AVX512,
+			CpuFeatureLevel::AVX512VNNI };
+	for (auto&& candidate : levels) {
+		if (name == getCpuFeatureLevelName(candidate)) {
+			level = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+}
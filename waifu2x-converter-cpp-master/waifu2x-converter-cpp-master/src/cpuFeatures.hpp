@@ -0,0 +1,53 @@
+/*
+ * cpuFeatures.hpp
+ *   SIMD instruction set level used by convolution kernels
+ *
+ *   The level is detected once with cpuid (and xgetbv for OS support of
+ *   AVX state), and may be lowered with setCpuFeatureLevel() for comparison.
+ *   Universal (universal intrinsics of OpenCV) is available on any CPU, and
+ *   is the level used on ARM (NEON).
+ */
+
+#ifndef CPU_FEATURES_HPP_
+#define CPU_FEATURES_HPP_
+
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define W2XC_X86
+#endif
+
+#if defined(W2XC_X86) && defined(__GNUC__)
+// compile a function for the instruction set without compiler flag
+#define W2XC_TARGET(isa) __attribute__((target(isa)))
+#else
+#define W2XC_TARGET(isa)
+#endif
+
+namespace w2xc {
+
+// ordered from lowest to highest
+enum class CpuFeatureLevel {
+	Scalar, Universal, SSE41, AVX2, AVX512, AVX512VNNI
+};
+// (AVX2 level includes FMA and F16C)
+
+// highest level supported by this CPU and OS
+CpuFeatureLevel detectCpuFeatureLevel();
+
+// level used by kernels (detected level unless set)
+CpuFeatureLevel getCpuFeatureLevel();
+// returns false if the CPU doesn't support the level
+bool setCpuFeatureLevel(CpuFeatureLevel level);
+
+// brand string of the CPU ("unknown" if not available)
+std::string getCpuModelName();
+
+// "scalar", "universal", "sse4.1", "avx2", "avx512", "avx512vnni"
+std::string getCpuFeatureLevelName(CpuFeatureLevel level);
+// returns false for unknown name
+bool parseCpuFeatureLevel(const std::string &name, CpuFeatureLevel &level);
+
+}
+
+#endif /* CPU_FEATURES_HPP_ */
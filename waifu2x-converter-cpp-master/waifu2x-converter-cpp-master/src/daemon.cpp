@@ -0,0 +1,364 @@
+/*
+ * daemon.cpp
+ *   daemon mode : conversion requests over UNIX domain socket
+ */
+
+#include "daemon.hpp"
+#include "picojson.h"
+#include <iostream>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+namespace w2xc {
+
+std::string getDefaultDaemonOutputDirectory() {
+	const char *directory = std::getenv("TMPDIR");
+	if (directory != nullptr && directory[0] != '\0')
+		return directory;
+	return "/tmp";
+}
+
+#ifdef _WIN32
+
+bool runDaemon(const std::string &socketPath,
+		const std::string &outputDirectory, ConversionModels &models,
+		const ExecutionContext &context) {
+	std::cerr << "Error : daemon mode is not supported on this platform"
+			<< std::endl;
+	return false;
+}
+
+#else
+
+// buffered reader of socket (lines and raw bytes)
+class SocketReader {
+
+private:
+	int fd;
+	std::vector<char> buffer;
+	std::size_t position;
+	std::size_t length;
+
+	bool fill() {
+		ssize_t n;
+		do {
+			n = ::read(fd, buffer.data(), buffer.size());
+		} while (n < 0 && errno == EINTR);
+		if (n <= 0)
+			return false;
+		position = 0;
+		length = static_cast<std::size_t>(n);
+		return true;
+	}
+
+public:
+	explicit SocketReader(int fd) :
+			fd(fd), buffer(1 << 16), position(0), length(0) {
+	}
+
+	// line without '\n' (false at end of connection, or if line is
+	// longer than maxLength, then tooLong is set)
+	bool readLine(std::string &line, std::size_t maxLength, bool &tooLong) {
+		line.clear();
+		tooLong = false;
+		while (true) {
+			if (position == length && !fill())
+				return false;
+			char c = buffer[position++];
+			if (c == '\n')
+				return true;
+			if (line.size() == maxLength) {
+				tooLong = true;
+				return false;
+			}
+			line.push_back(c);
+		}
+	}
+
+	bool readBytes(std::vector<unsigned char> &data, std::size_t size) {
+		data.resize(size);
+		std::size_t done = 0;
+		while (done < size) {
+			if (position == length && !fill())
+				return false;
+			std::size_t n = std::min(size - done, length - position);
+			std::memcpy(data.data() + done, buffer.data() + position, n);
+			position += n;
+			done += n;
+		}
+		return true;
+	}
+
+};
+
+// longest request line
+static constexpr std::size_t maxRequestLineLength = 1 << 16;
+
+// number of output files named by daemon (for unique names)
+static std::atomic<unsigned int> outputCounter(0);
+
+// connections being served (daemon waits for them before returning)
+static int nConnections = 0;
+static std::mutex connectionMtx;
+static std::condition_variable connectionCv;
+
+static bool writeAll(int fd, const std::string &text) {
+	std::size_t done = 0;
+	while (done < text.size()) {
+		ssize_t n = ::write(fd, text.data() + done, text.size() - done);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		done += static_cast<std::size_t>(n);
+	}
+	return true;
+}
+
+static double getMilliseconds(std::chrono::steady_clock::time_point begin,
+		std::chrono::steady_clock::time_point end) {
+	return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+static picojson::object getErrorReply(const std::string &message) {
+	picojson::object reply;
+	reply["status"] = picojson::value("error");
+	reply["message"] = picojson::value(message);
+	return reply;
+}
+
+// serves one request. returns false when connection cannot go on
+// (broken request stream), after setting reply if it can be sent.
+static bool serveRequest(SocketReader &reader, const std::string &line,
+		const std::string &outputDirectory, ConversionModels &models,
+		const ExecutionContext &context, picojson::object &reply) {
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point beginTime = Clock::now();
+
+	picojson::value requestValue;
+	std::string errMsg = picojson::parse(requestValue, line);
+	if (!errMsg.empty() || !requestValue.is<picojson::object>()) {
+		reply = getErrorReply("request is not a JSON object");
+		return true;
+	}
+	picojson::object &request = requestValue.get<picojson::object>();
+
+	// inline bytes are read first, so that the stream stays in sync
+	// even if the request is refused
+	std::vector<unsigned char> inputData;
+	bool inlineInput = request.count("input_size") > 0;
+	if (inlineInput) {
+		if (!request["input_size"].is<double>()
+				|| request["input_size"].get<double>() < 0.0
+				|| request["input_size"].get<double>() > maxDaemonInputSize) {
+			reply = getErrorReply("invalid input_size");
+			return false;
+		}
+		std::size_t inputSize = static_cast<std::size_t>(
+				request["input_size"].get<double>());
+		if (!reader.readBytes(inputData, inputSize)) {
+			reply = getErrorReply("input is shorter than input_size");
+			return false;
+		}
+	} else if (!request["input"].is<std::string>()) {
+		reply = getErrorReply("input or input_size is required");
+		return true;
+	}
+
+	ConversionSettings settings;
+	settings.mode = "noise_scale";
+	settings.noiseLevel = 1;
+	settings.scaleRatio = 2.0;
+	if (request["mode"].is<std::string>())
+		settings.mode = request["mode"].get<std::string>();
+	if (request["noise_level"].is<double>())
+		settings.noiseLevel =
+				static_cast<int>(request["noise_level"].get<double>());
+	if (request["scale_ratio"].is<double>())
+		settings.scaleRatio = request["scale_ratio"].get<double>();
+	if (!isValidConversionSettings(settings)) {
+		reply = getErrorReply("invalid mode, noise_level or scale_ratio");
+		return true;
+	}
+
+	std::string outputFileName;
+	if (request["output"].is<std::string>()) {
+		outputFileName = request["output"].get<std::string>();
+	} else if (inlineInput) {
+		outputFileName = getAutoOutputFileName(
+				outputDirectory + "/w2xc_" + std::to_string(getpid()) + "_"
+						+ std::to_string(outputCounter++) + ".png", settings);
+	} else {
+		outputFileName = getAutoOutputFileName(
+				request["input"].get<std::string>(), settings);
+	}
+
+	PlanarImage image;
+	bool decoded = inlineInput ?
+			decodeImage(inputData, image, context.threadPool) :
+			decodeImage(request["input"].get<std::string>(), image,
+					context.threadPool);
+	inputData.clear();
+	if (!decoded) {
+		reply = getErrorReply("couldn't read input image");
+		return true;
+	}
+	Clock::time_point decodedTime = Clock::now();
+
+	bool converted;
+	try {
+		converted = convertImage(image, settings, models, context);
+	} catch (std::exception &e) {
+		std::cerr << "Error : " << e.what() << std::endl;
+		converted = false;
+	}
+	if (!converted) {
+		reply = getErrorReply("conversion failed");
+		return true;
+	}
+	Clock::time_point convertedTime = Clock::now();
+
+	if (!encodeImage(image, outputFileName, context.threadPool)) {
+		reply = getErrorReply("couldn't write " + outputFileName);
+		return true;
+	}
+	Clock::time_point encodedTime = Clock::now();
+
+	reply["status"] = picojson::value("ok");
+	reply["output"] = picojson::value(outputFileName);
+	reply["decode_ms"] = picojson::value(
+			getMilliseconds(beginTime, decodedTime));
+	reply["convert_ms"] = picojson::value(
+			getMilliseconds(decodedTime, convertedTime));
+	reply["encode_ms"] = picojson::value(
+			getMilliseconds(convertedTime, encodedTime));
+	reply["total_ms"] = picojson::value(
+			getMilliseconds(beginTime, encodedTime));
+	return true;
+}
+
+static void serveConnection(int fd, const std::string &outputDirectory,
+		ConversionModels &models, const ExecutionContext &context) {
+	SocketReader reader(fd);
+	std::string line;
+	bool tooLong;
+	while (reader.readLine(line, maxRequestLineLength, tooLong)) {
+		if (line.empty() || line == "\r")
+			continue;
+		picojson::object reply;
+		bool goOn = serveRequest(reader, line, outputDirectory, models,
+				context, reply);
+		if (!writeAll(fd, picojson::value(reply).serialize() + "\n")
+				|| !goOn) {
+			break;
+		}
+	}
+	if (tooLong) {
+		picojson::object reply = getErrorReply("request line is too long");
+		writeAll(fd, picojson::value(reply).serialize() + "\n");
+	}
+	::close(fd);
+
+	std::lock_guard<std::mutex> lock(connectionMtx);
+	nConnections--;
+	connectionCv.notify_all();
+}
+
+bool runDaemon(const std::string &socketPath,
+		const std::string &outputDirectory, ConversionModels &models,
+		const ExecutionContext &context) {
+
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path)) {
+		std::cerr << "Error : socket path " << socketPath << " is too long"
+				<< std::endl;
+		return false;
+	}
+	std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size());
+
+	int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0) {
+		std::cerr << "Error : couldn't create socket : "
+				<< std::strerror(errno) << std::endl;
+		return false;
+	}
+	// only a socket left by previous daemon is replaced
+	struct stat status;
+	if (::lstat(socketPath.c_str(), &status) == 0) {
+		if (!S_ISSOCK(status.st_mode)) {
+			std::cerr << "Error : " << socketPath
+					<< " exists and is not a socket" << std::endl;
+			::close(listenFd);
+			return false;
+		}
+		::unlink(socketPath.c_str());
+	} else if (errno != ENOENT) {
+		std::cerr << "Error : couldn't stat " << socketPath << " : "
+				<< std::strerror(errno) << std::endl;
+		::close(listenFd);
+		return false;
+	}
+	if (::bind(listenFd, reinterpret_cast<sockaddr *>(&address),
+			sizeof(address)) != 0 || ::listen(listenFd, SOMAXCONN) != 0) {
+		std::cerr << "Error : couldn't listen on " << socketPath << " : "
+				<< std::strerror(errno) << std::endl;
+		::close(listenFd);
+		return false;
+	}
+
+	// closed connection must not kill the daemon while writing reply
+	signal(SIGPIPE, SIG_IGN);
+
+	std::cout << "waiting for requests on " << socketPath << std::endl;
+	while (true) {
+		// further clients wait in the listen queue
+		{
+			std::unique_lock<std::mutex> lock(connectionMtx);
+			connectionCv.wait(lock,
+					[] {return nConnections < maxDaemonConnections;});
+		}
+		int fd = ::accept(listenFd, nullptr, nullptr);
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			std::cerr << "Error : accept() failed : " << std::strerror(errno)
+					<< std::endl;
+			break;
+		}
+		{
+			std::lock_guard<std::mutex> lock(connectionMtx);
+			nConnections++;
+		}
+		std::thread(serveConnection, fd, outputDirectory, std::ref(models),
+				context).detach();
+	}
+
+	::close(listenFd);
+	::unlink(socketPath.c_str());
+
+	// models must outlive connections
+	std::unique_lock<std::mutex> lock(connectionMtx);
+	connectionCv.wait(lock, [] {return nConnections == 0;});
+	return false;
+}
+
+#endif
+
+}
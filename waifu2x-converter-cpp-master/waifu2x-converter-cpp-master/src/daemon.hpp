@@ -0,0 +1,58 @@
+/*
+ * daemon.hpp
+ *   daemon mode : conversion requests over UNIX domain socket
+ *   (POSIX only)
+ *
+ *   Each connection sends requests one after another, and each request
+ *   gets one reply. A request is one line of JSON object :
+ *     "input"       : path to input image file, or
+ *     "input_size"  : number of bytes of encoded image (png, jpg, ...)
+ *                     which follow the line
+ *     "output"      : path to output image file (optional)
+ *     "mode"        : "noise", "scale" or "noise_scale" (default)
+ *     "noise_level" : 1 (default) or 2
+ *     "scale_ratio" : 2.0 (default)
+ *   and a reply is one line of JSON object :
+ *     "status"      : "ok" or "error"
+ *     "message"     : reason of error
+ *     "output"      : path to output image file
+ *     "decode_ms", "convert_ms", "encode_ms", "total_ms" : timings
+ *   Without "output", output file is named automatically, next to input
+ *   file, or in output directory of daemon for image bytes.
+ *
+ *   Connections are served by their own threads at the same time (up to
+ *   maxDaemonConnections, others wait until one is closed), and share
+ *   models loaded at start (and the thread pool).
+ */
+
+#ifndef DAEMON_HPP_
+#define DAEMON_HPP_
+
+#include <string>
+#include "imageConversion.hpp"
+
+namespace w2xc {
+
+// requests larger than this are refused
+constexpr std::size_t maxDaemonInputSize = 256 << 20;
+
+// connections served at the same time
+constexpr int maxDaemonConnections = 16;
+
+// directory of output files for image bytes ($TMPDIR or /tmp)
+std::string getDefaultDaemonOutputDirectory();
+
+/**
+ * serve requests on socketPath until the process is terminated.
+ * (existing socket file is replaced, other files are not)
+ * models must have models of all modes, and are run on context.
+ * returns false if socket cannot be opened, or daemon mode is not
+ * supported on this platform.
+ */
+bool runDaemon(const std::string &socketPath,
+		const std::string &outputDirectory, ConversionModels &models,
+		const ExecutionContext &context);
+
+}
+
+#endif /* DAEMON_HPP_ */
@@ -0,0 +1,42 @@
+/*
+ * errorReport.cpp
+ *   errors of model loading and conversion
+ */
+
+#include "errorReport.hpp"
+#include <iostream>
+
+namespace w2xc {
+
+static thread_local ErrorCollector *currentCollector = nullptr;
+
+void reportError(const std::string &message) {
+	if (currentCollector != nullptr) {
+		currentCollector->add(message);
+		return;
+	}
+	std::cerr << "Error : " << message << std::endl;
+}
+
+void reportWarning(const std::string &message) {
+	if (currentCollector == nullptr) {
+		std::cerr << message << std::endl;
+	}
+}
+
+ErrorCollector::ErrorCollector() :
+		outer(currentCollector) {
+	currentCollector = this;
+}
+
+ErrorCollector::~ErrorCollector() {
+	currentCollector = outer;
+}
+
+void ErrorCollector::add(const std::string &error) {
+	if (!message.empty())
+		message += " : ";
+	message += error;
+}
+
+}
@@ -0,0 +1,52 @@
+/*
+ * errorReport.hpp
+ *   errors of model loading and conversion, printed to std::cerr or
+ *   collected for the caller
+ */
+
+#ifndef ERROR_REPORT_HPP_
+#define ERROR_REPORT_HPP_
+
+#include <string>
+
+namespace w2xc {
+
+// "Error : message" to std::cerr, or to ErrorCollector of calling thread
+void reportError(const std::string &message);
+
+// notice which isn't an error (dropped while ErrorCollector exists)
+void reportWarning(const std::string &message);
+
+/**
+ * collects errors reported on the thread which creates it, while it
+ * exists (collectors can be nested, the innermost one gets errors).
+ * used by Converter, so that embedding applications get the details in
+ * errorMessage and nothing is written to std::cerr.
+ */
+class ErrorCollector {
+
+private:
+	ErrorCollector *outer;
+	std::string message;
+
+	ErrorCollector(const ErrorCollector &) = delete;
+	ErrorCollector &operator=(const ErrorCollector &) = delete;
+
+public:
+	ErrorCollector();
+	~ErrorCollector();
+
+	void add(const std::string &error);
+	bool empty() const {
+		return message.empty();
+	}
+	// errors in order of report, separated by " : "
+	const std::string &getMessage() const {
+		return message;
+	}
+
+};
+
+}
+
+#endif /* ERROR_REPORT_HPP_ */
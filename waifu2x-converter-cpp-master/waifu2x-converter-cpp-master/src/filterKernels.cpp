@@ -0,0 +1,123 @@
+/*
+ * filterKernels.cpp
+ *   convolution kernels used by Model::filterWorker
+ *   (scalar reference kernel and selection by CPU features)
+ */
+
+#include "filterKernelsImpl.hpp"
+#include "activationTensor.hpp"
+#include <algorithm>
+
+namespace w2xc {
+
+// number of output pixels accumulated at once
+// (tilePixels x weightBlockSize accumulators are kept in registers)
+static constexpr int tilePixels = 8;
+
+// accumulate one input channel into acc for nPixels pixels
+// rows : upper, center, lower row of the channel at pixel (x0 - 1)
+// (called with nPixels == tilePixels for full tiles, so that the trip count
+//  is fixed after inlining)
+static inline void accumulateChannel(const float * const *rows,
+		const float *w, float (*acc)[weightBlockSize], int nPixels) {
+	constexpr int C = tensorChannelBlock;
+	for (int tap = 0; tap < 9; tap++) {
+		const float *row = rows[tap / 3] + (tap % 3) * C;
+		const float *wt = w + tap * weightBlockSize;
+		for (int x = 0; x < nPixels; x++) {
+			const float v = row[x * C];
+			for (int lane = 0; lane < weightBlockSize; lane++) {
+				acc[x][lane] += v * wt[lane];
+			}
+		}
+	}
+}
+
+// one output block
+static void filterRow3x3PackedBlock(const float * const *inputRows,
+		int nInputPlanes, const float *blockWeights, const float *blockBiases,
+		float *outputRow, int width) {
+
+	constexpr int C = tensorChannelBlock;
+	float acc[tilePixels][weightBlockSize];
+
+	for (int x0 = 0; x0 < width; x0 += tilePixels) {
+		int nPixels = std::min(tilePixels, width - x0);
+
+		for (int x = 0; x < nPixels; x++) {
+			std::fill(acc[x], acc[x] + weightBlockSize, 0.0f);
+		}
+
+		for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+			// neighbour columns are in the halo at borders (no clamping)
+			const float *rows[3];
+			for (int k = 0; k < 3; k++) {
+				rows[k] = inputRows[(ipIndex / C) * 3 + k] + (x0 - 1) * C
+						+ ipIndex % C;
+			}
+			// weights of the block are read linearly
+			const float *w = blockWeights + ipIndex * 9 * weightBlockSize;
+
+			if (nPixels == tilePixels) {
+				accumulateChannel(rows, w, acc, tilePixels);
+			} else {
+				accumulateChannel(rows, w, acc, nPixels);
+			}
+		} // for ipIndex
+
+		float *out = outputRow + x0 * C;
+		for (int x = 0; x < nPixels; x++) {
+			for (int lane = 0; lane < weightBlockSize; lane++) {
+				float v = acc[x][lane] + blockBiases[lane];
+				out[x * C + lane] = v > 0.0f ? v : v * 0.1f;
+			}
+		}
+
+	} // for x0
+
+}
+
+void filterRow3x3PackedScalar(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width) {
+	for (int i = 0; i < nBlocks; i++) {
+		filterRow3x3PackedBlock(inputRows, nInputPlanes,
+				weights.getBlockWeights(beginningBlock + i),
+				weights.getBlockBiases(beginningBlock + i), outputRows[i],
+				width);
+	}
+}
+
+void filterRow3x3Packed(const float * const *inputRows, int nInputPlanes,
+		const PackedWeights &weights, int beginningBlock, int nBlocks,
+		float * const *outputRows, int width) {
+
+	switch (getCpuFeatureLevel()) {
+#ifdef W2XC_X86
+	case CpuFeatureLevel::AVX512VNNI:
+	case CpuFeatureLevel::AVX512:
+		filterRow3x3PackedAVX512(inputRows, nInputPlanes, weights,
+				beginningBlock, nBlocks, outputRows, width);
+		break;
+	case CpuFeatureLevel::AVX2:
+		filterRow3x3PackedAVX2(inputRows, nInputPlanes, weights,
+				beginningBlock, nBlocks, outputRows, width);
+		break;
+	case CpuFeatureLevel::SSE41:
+		filterRow3x3PackedSSE41(inputRows, nInputPlanes, weights,
+				beginningBlock, nBlocks, outputRows, width);
+		break;
+#endif
+	case CpuFeatureLevel::Universal:
+		filterRow3x3PackedUniversal(inputRows, nInputPlanes, weights,
+				beginningBlock, nBlocks, outputRows, width);
+		break;
+	default:
+		filterRow3x3PackedScalar(inputRows, nInputPlanes, weights,
+				beginningBlock, nBlocks, outputRows, width);
+		break;
+	}
+
+}
+
+}
@@ -0,0 +1,95 @@
+/*
+ * filterKernels.hpp
+ *   convolution kernels used by Model::filterWorker
+ *
+ *   These kernels work on raw row pointers, so that they can be fed from
+ *   ActivationTensor as well as from other row buffers.
+ */
+
+#ifndef FILTER_KERNELS_HPP_
+#define FILTER_KERNELS_HPP_
+
+#include "packedWeights.hpp"
+#include "quantization.hpp"
+
+namespace w2xc {
+
+// number of output blocks computed together by the widest kernel (AVX-512)
+// (callers should pass ranges of this many blocks where possible)
+constexpr int filterRowBlocks = 2;
+
+/**
+ * compute one row of output blocks [beginningBlock, beginningBlock + nBlocks)
+ * (weightBlockSize output planes each) by 3x3 convolution over all input
+ * planes, and then add bias and apply LeakyReLU(0.1), in the same pass.
+ * rows are in channel-blocked layout of ActivationTensor.
+ *
+ * inputRows  : 3 row pointers (upper, center, lower) per input channel
+ *              block, inputRows[ipBlock * 3 + 0..2], pointing to pixel 0
+ *              (pixels -1 and width must be readable, see ActivationTensor)
+ * weights    : packed weights and biases of the layer
+ * outputRows : pixel 0 of the row of each output block,
+ *              outputRows[0 .. nBlocks - 1]
+ *
+ * each pixel of output rows is written exactly once
+ * (channels in the padding of the block are written as zero).
+ *
+ * the kernel is selected by getCpuFeatureLevel() (scalar, universal
+ * intrinsics, SSE4.1, AVX2 + FMA or AVX-512F). all of them sum in the same
+ * order, so universal (on SSE2 or emulation) and SSE4.1 match the scalar
+ * kernel exactly. FMA rounds once per multiply-add, so AVX2, AVX-512 (and
+ * universal on NEON, where vmla may be fused) differ by rounding only
+ * (tolerance : 1e-5 absolute per layer for activations of order 1,
+ *  about 1.2e-6 measured on 128->128 layers; checked by compareKernels.cpp).
+ */
+void filterRow3x3Packed(const float * const *inputRows, int nInputPlanes,
+		const PackedWeights &weights, int beginningBlock, int nBlocks,
+		float * const *outputRows, int width);
+
+// row kernel of a layer (same arguments as filterRow3x3Packed())
+typedef void (*FilterRowKernel)(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width);
+
+/**
+ * row kernel specialized at compile time for the layer shape
+ * (filterKernelsSpecialized.cpp, 3x3 layers of waifu2x models on x86),
+ * or filterRow3x3Packed() for other shapes.
+ * the kernel is bound once after loading the layer; it checks
+ * getCpuFeatureLevel() on each call and uses filterRow3x3Packed() below
+ * AVX2. results differ from it by rounding only (128->1 sums input planes
+ * in other order).
+ */
+FilterRowKernel findFilterRowKernel(int nInputPlanes, int nOutputPlanes,
+		int kernelSize);
+
+/**
+ * INT8 version of filterRow3x3Packed() (see quantization.hpp)
+ *
+ * inputRows  : 3 quantized rows (upper, center, lower), pointing to pixel 0
+ *              (pixels -1 and width must be readable)
+ * weights    : quantized weights, zero point and scales of the layer
+ * outputRows : pixel 0 of the row of each output block (float,
+ *              channel-blocked layout of ActivationTensor)
+ *
+ * products are summed in int32, then dequantized, added bias and applied
+ * LeakyReLU(0.1). the kernel is selected by getCpuFeatureLevel()
+ * (scalar below AVX2, pmaddubsw on AVX2 and AVX-512F, vpdpbusd on
+ *  AVX-512 VNNI). integer sums are the same for all of them, so the
+ * results differ only by rounding of dequantization (the compiler may
+ * contract the scalar multiply and bias add into FMA).
+ */
+void filterRow3x3Int8(const uint8_t * const *inputRows,
+		const QuantizedWeights &weights, int beginningBlock, int nBlocks,
+		float * const *outputRows, int width);
+
+/**
+ * outputRow[x * outputStride] = LeakyReLU(0.1)(inputRow[x] + bias)
+ * (inputRow and outputRow may be the same buffer if outputStride is 1)
+ */
+void biasLeakyReLU(const float *inputRow, float bias, float *outputRow,
+		int width, int outputStride = 1);
+
+}
+
+#endif /* FILTER_KERNELS_HPP_ */
@@ -0,0 +1,53 @@
+/*
+ * filterKernelsImpl.hpp
+ *   instruction set specific implementations of filterRow3x3Packed() and
+ *   filterRow3x3Int8()
+ *   (internal to filterKernels*.cpp)
+ */
+
+#ifndef FILTER_KERNELS_IMPL_HPP_
+#define FILTER_KERNELS_IMPL_HPP_
+
+#include "filterKernels.hpp"
+#include "cpuFeatures.hpp"
+
+namespace w2xc {
+
+void filterRow3x3PackedScalar(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width);
+// universal intrinsics of OpenCV (SSE2, NEON or C++ emulation)
+void filterRow3x3PackedUniversal(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width);
+
+#ifdef W2XC_X86
+void filterRow3x3PackedSSE41(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width);
+void filterRow3x3PackedAVX2(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width);
+void filterRow3x3PackedAVX512(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width);
+#endif
+
+void filterRow3x3Int8Scalar(const uint8_t * const *inputRows,
+		const QuantizedWeights &weights, int beginningBlock, int nBlocks,
+		float * const *outputRows, int width);
+
+#ifdef W2XC_X86
+// pmaddubsw
+void filterRow3x3Int8AVX2(const uint8_t * const *inputRows,
+		const QuantizedWeights &weights, int beginningBlock, int nBlocks,
+		float * const *outputRows, int width);
+// vpdpbusd
+void filterRow3x3Int8AVX512VNNI(const uint8_t * const *inputRows,
+		const QuantizedWeights &weights, int beginningBlock, int nBlocks,
+		float * const *outputRows, int width);
+#endif
+
+}
+
+#endif /* FILTER_KERNELS_IMPL_HPP_ */
@@ -0,0 +1,87 @@
+/*
+ * filterKernelsInt8.cpp
+ *   INT8 convolution kernel used by Model::filterWorkerInt8
+ *   (scalar reference kernel and selection by CPU features)
+ */
+
+#include "filterKernelsImpl.hpp"
+#include "activationTensor.hpp"
+#include <algorithm>
+
+namespace w2xc {
+
+// one output block
+static void filterRowInt8Block(const uint8_t * const *inputRows,
+		int nInputPlanes, const int8_t *blockWeights, const float *scales,
+		const int32_t *offsets, const float *biases, float *outputRow,
+		int width) {
+
+	constexpr int C = tensorChannelBlock;
+	const int pixelBytes = getInt8PixelBytes(nInputPlanes);
+	const int nGroups = pixelBytes / int8GroupSize;
+
+	for (int x = 0; x < width; x++) {
+		int32_t acc[weightBlockSize] = { 0 };
+
+		for (int group = 0; group < nGroups; group++) {
+			for (int tap = 0; tap < 9; tap++) {
+				// neighbour columns are in the halo at borders (no clamping)
+				const uint8_t *in = inputRows[tap / 3]
+						+ (x - 1 + tap % 3) * pixelBytes + group * int8GroupSize;
+				const int8_t *w = blockWeights
+						+ (group * 9 + tap) * weightBlockSize * int8GroupSize;
+				for (int lane = 0; lane < weightBlockSize; lane++) {
+					for (int i = 0; i < int8GroupSize; i++) {
+						acc[lane] += in[i] * w[lane * int8GroupSize + i];
+					}
+				}
+			}
+		} // for group
+
+		float *out = outputRow + x * C;
+		for (int lane = 0; lane < weightBlockSize; lane++) {
+			float v = static_cast<float>(acc[lane] - offsets[lane])
+					* scales[lane] + biases[lane];
+			out[lane] = std::max(v, v * 0.1f);
+		}
+	} // for x
+
+}
+
+void filterRow3x3Int8Scalar(const uint8_t * const *inputRows,
+		const QuantizedWeights &weights, int beginningBlock, int nBlocks,
+		float * const *outputRows, int width) {
+	for (int i = 0; i < nBlocks; i++) {
+		int ob = beginningBlock + i;
+		filterRowInt8Block(inputRows, weights.getNInputPlanes(),
+				weights.getBlockWeights(ob), weights.getBlockScales(ob),
+				weights.getBlockOffsets(ob), weights.getBlockBiases(ob),
+				outputRows[i], width);
+	}
+}
+
+void filterRow3x3Int8(const uint8_t * const *inputRows,
+		const QuantizedWeights &weights, int beginningBlock, int nBlocks,
+		float * const *outputRows, int width) {
+
+	switch (getCpuFeatureLevel()) {
+#ifdef W2XC_X86
+	case CpuFeatureLevel::AVX512VNNI:
+		filterRow3x3Int8AVX512VNNI(inputRows, weights, beginningBlock,
+				nBlocks, outputRows, width);
+		break;
+	case CpuFeatureLevel::AVX512:
+	case CpuFeatureLevel::AVX2:
+		filterRow3x3Int8AVX2(inputRows, weights, beginningBlock, nBlocks,
+				outputRows, width);
+		break;
+#endif
+	default:
+		filterRow3x3Int8Scalar(inputRows, weights, beginningBlock, nBlocks,
+				outputRows, width);
+		break;
+	}
+
+}
+
+}
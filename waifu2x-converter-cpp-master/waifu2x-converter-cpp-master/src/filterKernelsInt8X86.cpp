@@ -0,0 +1,212 @@
+/*
+ * filterKernelsInt8X86.cpp
+ *   AVX2 (pmaddubsw) and AVX-512 VNNI (vpdpbusd) implementations of
+ *   filterRow3x3Int8()
+ *
+ *   Each lane of a register holds one output plane, and its 4 bytes
+ *   multiply-add 4 input planes of a pixel (one int8 group), so that an
+ *   input group is broadcast as one 32-bit value.
+ */
+
+#include "filterKernelsImpl.hpp"
+#include "activationTensor.hpp"
+
+#ifdef W2XC_X86
+
+#include <immintrin.h>
+#include <algorithm>
+#include <cstring>
+
+namespace w2xc {
+
+static constexpr int C = tensorChannelBlock;
+
+// bytes of weights per (group, tap) of a block
+static constexpr int groupTapBytes = weightBlockSize * int8GroupSize;
+
+// 4 input planes of a pixel as one 32-bit value
+static inline int loadGroup(const uint8_t *ptr) {
+	int32_t value;
+	std::memcpy(&value, ptr, sizeof(value));
+	return value;
+}
+
+// ===== AVX2 : one block is 1 register =====
+
+static constexpr int tilePixelsInt8AVX2 = 8;
+
+W2XC_TARGET("avx2")
+static inline void accumulateGroupAVX2(const uint8_t * const *inputRows,
+		int pixelBytes, int x0, int group, const int8_t *w, __m256i *acc,
+		int nPixels) {
+	const __m256i ones = _mm256_set1_epi16(1);
+	for (int tap = 0; tap < 9; tap++) {
+		const uint8_t *in = inputRows[tap / 3]
+				+ (x0 - 1 + tap % 3) * pixelBytes + group * int8GroupSize;
+		const __m256i wt = _mm256_load_si256(
+				reinterpret_cast<const __m256i *>(w + tap * groupTapBytes));
+		for (int x = 0; x < nPixels; x++) {
+			// u8 x s8 pairs summed to s16 (no saturation with 7-bit weights),
+			// then pairs of them to s32
+			__m256i products = _mm256_maddubs_epi16(
+					_mm256_set1_epi32(loadGroup(in + x * pixelBytes)), wt);
+			acc[x] = _mm256_add_epi32(acc[x],
+					_mm256_madd_epi16(products, ones));
+		}
+	}
+}
+
+W2XC_TARGET("avx2")
+static inline __m256 dequantizeAVX2(__m256i acc, __m256i offsets,
+		__m256 scales, __m256 biases) {
+	__m256 v = _mm256_add_ps(
+			_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(acc, offsets)),
+					scales), biases);
+	return _mm256_max_ps(v, _mm256_mul_ps(v, _mm256_set1_ps(0.1f)));
+}
+
+W2XC_TARGET("avx2")
+static void filterRowInt8BlockAVX2(const uint8_t * const *inputRows,
+		const QuantizedWeights &weights, int ob, float *outputRow, int width) {
+
+	const int pixelBytes = getInt8PixelBytes(weights.getNInputPlanes());
+	const int nGroups = pixelBytes / int8GroupSize;
+	const int8_t *blockWeights = weights.getBlockWeights(ob);
+	const __m256i offsets = _mm256_load_si256(
+			reinterpret_cast<const __m256i *>(weights.getBlockOffsets(ob)));
+	const __m256 scales = _mm256_load_ps(weights.getBlockScales(ob));
+	const __m256 biases = _mm256_load_ps(weights.getBlockBiases(ob));
+
+	for (int x0 = 0; x0 < width; x0 += tilePixelsInt8AVX2) {
+		int nPixels = std::min(tilePixelsInt8AVX2, width - x0);
+		__m256i acc[tilePixelsInt8AVX2];
+		for (int x = 0; x < tilePixelsInt8AVX2; x++) {
+			acc[x] = _mm256_setzero_si256();
+		}
+
+		for (int group = 0; group < nGroups; group++) {
+			const int8_t *w = blockWeights + group * 9 * groupTapBytes;
+			if (nPixels == tilePixelsInt8AVX2) {
+				accumulateGroupAVX2(inputRows, pixelBytes, x0, group, w, acc,
+						tilePixelsInt8AVX2);
+			} else {
+				accumulateGroupAVX2(inputRows, pixelBytes, x0, group, w, acc,
+						nPixels);
+			}
+		}
+
+		float *out = outputRow + x0 * C;
+		for (int x = 0; x < nPixels; x++) {
+			_mm256_storeu_ps(out + x * C,
+					dequantizeAVX2(acc[x], offsets, scales, biases));
+		}
+	} // for x0
+
+}
+
+void filterRow3x3Int8AVX2(const uint8_t * const *inputRows,
+		const QuantizedWeights &weights, int beginningBlock, int nBlocks,
+		float * const *outputRows, int width) {
+	for (int i = 0; i < nBlocks; i++) {
+		filterRowInt8BlockAVX2(inputRows, weights, beginningBlock + i,
+				outputRows[i], width);
+	}
+}
+
+// ===== AVX-512 VNNI : two blocks are 1 register =====
+// (lower half : block b, upper half : block b + 1, same as float kernel)
+
+static constexpr int tilePixelsInt8AVX512 = 16;
+
+W2XC_TARGET("avx512f,avx512vnni")
+static inline void accumulateGroupAVX512VNNI(const uint8_t * const *inputRows,
+		int pixelBytes, int x0, int group, const int8_t *w0, const int8_t *w1,
+		__m512i *acc, int nPixels) {
+	for (int tap = 0; tap < 9; tap++) {
+		const uint8_t *in = inputRows[tap / 3]
+				+ (x0 - 1 + tap % 3) * pixelBytes + group * int8GroupSize;
+		const __m512i wt = _mm512_inserti64x4(
+				_mm512_castsi256_si512(
+						_mm256_load_si256(
+								reinterpret_cast<const __m256i *>(w0
+										+ tap * groupTapBytes))),
+				_mm256_load_si256(
+						reinterpret_cast<const __m256i *>(w1
+								+ tap * groupTapBytes)), 1);
+		for (int x = 0; x < nPixels; x++) {
+			acc[x] = _mm512_dpbusd_epi32(acc[x],
+					_mm512_set1_epi32(loadGroup(in + x * pixelBytes)), wt);
+		}
+	}
+}
+
+W2XC_TARGET("avx512f,avx512vnni")
+static void filterRowInt8BlockPairAVX512VNNI(const uint8_t * const *inputRows,
+		const QuantizedWeights &weights, int ob, float *outputRow0,
+		float *outputRow1, int width) {
+
+	const int pixelBytes = getInt8PixelBytes(weights.getNInputPlanes());
+	const int nGroups = pixelBytes / int8GroupSize;
+	const int8_t *weights0 = weights.getBlockWeights(ob);
+	const int8_t *weights1 = weights.getBlockWeights(ob + 1);
+	// per plane values of block ob and ob + 1 are contiguous
+	const __m512i offsets = _mm512_loadu_si512(weights.getBlockOffsets(ob));
+	const __m512 scales = _mm512_loadu_ps(weights.getBlockScales(ob));
+	const __m512 biases = _mm512_loadu_ps(weights.getBlockBiases(ob));
+	const __m512 slope = _mm512_set1_ps(0.1f);
+
+	for (int x0 = 0; x0 < width; x0 += tilePixelsInt8AVX512) {
+		int nPixels = std::min(tilePixelsInt8AVX512, width - x0);
+		__m512i acc[tilePixelsInt8AVX512];
+		for (int x = 0; x < tilePixelsInt8AVX512; x++) {
+			acc[x] = _mm512_setzero_si512();
+		}
+
+		for (int group = 0; group < nGroups; group++) {
+			const int8_t *w0 = weights0 + group * 9 * groupTapBytes;
+			const int8_t *w1 = weights1 + group * 9 * groupTapBytes;
+			if (nPixels == tilePixelsInt8AVX512) {
+				accumulateGroupAVX512VNNI(inputRows, pixelBytes, x0, group, w0,
+						w1, acc, tilePixelsInt8AVX512);
+			} else {
+				accumulateGroupAVX512VNNI(inputRows, pixelBytes, x0, group, w0,
+						w1, acc, nPixels);
+			}
+		}
+
+		float *out0 = outputRow0 + x0 * C;
+		float *out1 = outputRow1 + x0 * C;
+		for (int x = 0; x < nPixels; x++) {
+			__m512 v = _mm512_add_ps(
+					_mm512_mul_ps(
+							_mm512_cvtepi32_ps(
+									_mm512_sub_epi32(acc[x], offsets)),
+							scales), biases);
+			v = _mm512_max_ps(v, _mm512_mul_ps(v, slope));
+			_mm256_storeu_ps(out0 + x * C, _mm512_castps512_ps256(v));
+			_mm256_storeu_ps(out1 + x * C,
+					_mm256_castpd_ps(
+							_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1)));
+		}
+	} // for x0
+
+}
+
+void filterRow3x3Int8AVX512VNNI(const uint8_t * const *inputRows,
+		const QuantizedWeights &weights, int beginningBlock, int nBlocks,
+		float * const *outputRows, int width) {
+	int i = 0;
+	for (; i + 1 < nBlocks; i += 2) {
+		filterRowInt8BlockPairAVX512VNNI(inputRows, weights,
+				beginningBlock + i, outputRows[i], outputRows[i + 1], width);
+	}
+	// odd block (VNNI CPUs have AVX2)
+	if (i < nBlocks) {
+		filterRow3x3Int8AVX2(inputRows, weights, beginningBlock + i, 1,
+				outputRows + i, width);
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * filterKernelsSpecialized.cpp
+ *   3x3 row kernels specialized at compile time for the layer shapes of
+ *   waifu2x models, and registry of them (see findFilterRowKernel())
+ *
+ *   Numbers of input and output planes are template parameters, so that
+ *   loops over input channels have fixed trip counts (and are unrolled in
+ *   each channel block). Register tiles are the same for all shapes
+ *   (12 pixels with AVX2, 16 with AVX-512F, 8 for narrow output); tiles
+ *   chosen per shape (narrower for 1->32 and 128->1) were not measurably
+ *   faster.
+ *   Layers with less output planes than a block (128->1) are vectorized
+ *   over input planes instead, since blocks of output planes would be
+ *   mostly padding.
+ *   Each kernel checks getCpuFeatureLevel() on call, and falls back to
+ *   filterRow3x3Packed() below AVX2.
+ */
+
+#include "filterKernelsImpl.hpp"
+#include "activationTensor.hpp"
+
+#ifdef W2XC_X86
+#include <immintrin.h>
+#include <algorithm>
+#endif
+
+#if defined(__GNUC__)
+#define W2XC_PRAGMA(x) _Pragma(#x)
+#define W2XC_UNROLL(n) W2XC_PRAGMA(GCC unroll n)
+#else
+#define W2XC_UNROLL(n)
+#endif
+
+namespace w2xc {
+
+#ifdef W2XC_X86
+
+static constexpr int C = tensorChannelBlock;
+
+// ===== AVX2 + FMA : one output block is 1 register =====
+
+static constexpr int specializedTileAVX2 = 12;
+
+// nChannels channels of an input block
+W2XC_TARGET("avx2,fma")
+static inline void accumulateChannelsAVX2(const float * const *rows,
+		const float *w, __m256 *acc, int nChannels, int nPixels) {
+	W2XC_UNROLL(8)
+	for (int c = 0; c < nChannels; c++) {
+		for (int tap = 0; tap < 9; tap++) {
+			const float *row = rows[tap / 3] + (tap % 3) * C + c;
+			const __m256 wt = _mm256_load_ps(
+					w + (c * 9 + tap) * weightBlockSize);
+			for (int x = 0; x < nPixels; x++) {
+				acc[x] = _mm256_fmadd_ps(_mm256_broadcast_ss(row + x * C), wt,
+						acc[x]);
+			}
+		}
+	}
+}
+
+// (called with nPixels == specializedTileAVX2 for full tiles)
+template<int NIN>
+W2XC_TARGET("avx2,fma")
+static inline void accumulateSpecializedAVX2(const float * const *inputRows,
+		const float *blockWeights, int x0, __m256 *acc, int nPixels) {
+	constexpr int nInBlocks = (NIN + C - 1) / C;
+	for (int ib = 0; ib < nInBlocks; ib++) {
+		const float *rows[3];
+		for (int k = 0; k < 3; k++) {
+			rows[k] = inputRows[ib * 3 + k] + (x0 - 1) * C;
+		}
+		const float *w = blockWeights + ib * C * 9 * weightBlockSize;
+		if (ib < NIN / C) {
+			accumulateChannelsAVX2(rows, w, acc, C, nPixels);
+		} else {
+			accumulateChannelsAVX2(rows, w, acc, NIN % C, nPixels);
+		}
+	}
+}
+
+template<int NIN>
+W2XC_TARGET("avx2,fma")
+static void filterRowBlockSpecializedAVX2(const float * const *inputRows,
+		const float *blockWeights, const float *blockBiases, float *outputRow,
+		int width) {
+
+	const __m256 bias = _mm256_load_ps(blockBiases);
+	const __m256 slope = _mm256_set1_ps(0.1f);
+
+	for (int x0 = 0; x0 < width; x0 += specializedTileAVX2) {
+		int nPixels = std::min(specializedTileAVX2, width - x0);
+		__m256 acc[specializedTileAVX2];
+		for (int x = 0; x < specializedTileAVX2; x++) {
+			acc[x] = _mm256_setzero_ps();
+		}
+
+		if (nPixels == specializedTileAVX2) {
+			accumulateSpecializedAVX2<NIN>(inputRows, blockWeights, x0, acc,
+					specializedTileAVX2);
+		} else {
+			accumulateSpecializedAVX2<NIN>(inputRows, blockWeights, x0, acc,
+					nPixels);
+		}
+
+		float *out = outputRow + x0 * C;
+		for (int x = 0; x < nPixels; x++) {
+			__m256 v = _mm256_add_ps(acc[x], bias);
+			_mm256_storeu_ps(out + x * C,
+					_mm256_max_ps(v, _mm256_mul_ps(v, slope)));
+		}
+	} // for x0
+
+}
+
+// ===== AVX-512F : two output blocks are 1 register =====
+
+static constexpr int specializedTileAVX512 = 16;
+
+W2XC_TARGET("avx512f")
+static inline __m512 combineBlocks(__m256 lower, __m256 upper) {
+	return _mm512_castpd_ps(
+			_mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(lower)),
+					_mm256_castps_pd(upper), 1));
+}
+
+// nChannels channels of an input block
+W2XC_TARGET("avx512f")
+static inline void accumulateChannelsAVX512(const float * const *rows,
+		const float *w0, const float *w1, __m512 *acc, int nChannels,
+		int nPixels) {
+	W2XC_UNROLL(8)
+	for (int c = 0; c < nChannels; c++) {
+		for (int tap = 0; tap < 9; tap++) {
+			const float *row = rows[tap / 3] + (tap % 3) * C + c;
+			const __m512 wt = combineBlocks(
+					_mm256_load_ps(w0 + (c * 9 + tap) * weightBlockSize),
+					_mm256_load_ps(w1 + (c * 9 + tap) * weightBlockSize));
+			for (int x = 0; x < nPixels; x++) {
+				acc[x] = _mm512_fmadd_ps(_mm512_set1_ps(row[x * C]), wt, acc[x]);
+			}
+		}
+	}
+}
+
+// (called with nPixels == specializedTileAVX512 for full tiles)
+template<int NIN>
+W2XC_TARGET("avx512f")
+static inline void accumulateSpecializedAVX512(const float * const *inputRows,
+		const float *weights0, const float *weights1, int x0, __m512 *acc,
+		int nPixels) {
+	constexpr int nInBlocks = (NIN + C - 1) / C;
+	for (int ib = 0; ib < nInBlocks; ib++) {
+		const float *rows[3];
+		for (int k = 0; k < 3; k++) {
+			rows[k] = inputRows[ib * 3 + k] + (x0 - 1) * C;
+		}
+		const float *w0 = weights0 + ib * C * 9 * weightBlockSize;
+		const float *w1 = weights1 + ib * C * 9 * weightBlockSize;
+		if (ib < NIN / C) {
+			accumulateChannelsAVX512(rows, w0, w1, acc, C, nPixels);
+		} else {
+			accumulateChannelsAVX512(rows, w0, w1, acc, NIN % C, nPixels);
+		}
+	}
+}
+
+template<int NIN>
+W2XC_TARGET("avx512f")
+static void filterRowBlockPairSpecializedAVX512(
+		const float * const *inputRows, const float *weights0,
+		const float *weights1, const float *biases0, const float *biases1,
+		float *outputRow0, float *outputRow1, int width) {
+
+	const __m512 bias = combineBlocks(_mm256_load_ps(biases0),
+			_mm256_load_ps(biases1));
+	const __m512 slope = _mm512_set1_ps(0.1f);
+
+	for (int x0 = 0; x0 < width; x0 += specializedTileAVX512) {
+		int nPixels = std::min(specializedTileAVX512, width - x0);
+		__m512 acc[specializedTileAVX512];
+		for (int x = 0; x < specializedTileAVX512; x++) {
+			acc[x] = _mm512_setzero_ps();
+		}
+
+		if (nPixels == specializedTileAVX512) {
+			accumulateSpecializedAVX512<NIN>(inputRows, weights0, weights1, x0,
+					acc, specializedTileAVX512);
+		} else {
+			accumulateSpecializedAVX512<NIN>(inputRows, weights0, weights1, x0,
+					acc, nPixels);
+		}
+
+		float *out0 = outputRow0 + x0 * C;
+		float *out1 = outputRow1 + x0 * C;
+		for (int x = 0; x < nPixels; x++) {
+			__m512 v = _mm512_add_ps(acc[x], bias);
+			v = _mm512_max_ps(v, _mm512_mul_ps(v, slope));
+			_mm256_storeu_ps(out0 + x * C, _mm512_castps512_ps256(v));
+			_mm256_storeu_ps(out1 + x * C,
+					_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v),
+							1)));
+		}
+	} // for x0
+
+}
+
+// ===== narrow output (less than weightBlockSize planes), AVX2 + FMA =====
+// each output plane is accumulated over input channels of a block in one
+// register, and summed horizontally at the end of the pixel
+
+static constexpr int narrowTilePixels = 8;
+
+W2XC_TARGET("avx2,fma")
+static inline float horizontalSum(__m256 v) {
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(v),
+			_mm256_extractf128_ps(v, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_movehdup_ps(s));
+	return _mm_cvtss_f32(s);
+}
+
+// (called with nPixels == narrowTilePixels for full tiles)
+template<int NIN, int NOUT>
+W2XC_TARGET("avx2,fma")
+static inline void accumulateNarrowAVX2(const float * const *inputRows,
+		const PackedWeights &weights, int x0,
+		__m256 (*acc)[narrowTilePixels], int nPixels) {
+	constexpr int nInBlocks = (NIN + C - 1) / C;
+	const int nPaddedInputPlanes = weights.getNPaddedInputPlanes();
+	for (int ib = 0; ib < nInBlocks; ib++) {
+		for (int tap = 0; tap < 9; tap++) {
+			const float *row = inputRows[ib * 3 + tap / 3]
+					+ (x0 - 1 + tap % 3) * C;
+			for (int op = 0; op < NOUT; op++) {
+				const __m256 wt = _mm256_load_ps(weights.getNarrowWeights(op)
+						+ tap * nPaddedInputPlanes + ib * C);
+				for (int x = 0; x < nPixels; x++) {
+					acc[op][x] = _mm256_fmadd_ps(_mm256_loadu_ps(row + x * C),
+							wt, acc[op][x]);
+				}
+			}
+		}
+	}
+}
+
+template<int NIN, int NOUT>
+W2XC_TARGET("avx2,fma")
+static void filterRowNarrowAVX2(const float * const *inputRows,
+		const PackedWeights &weights, float *outputRow, int width) {
+
+	const float *biases = weights.getBiases();
+
+	for (int x0 = 0; x0 < width; x0 += narrowTilePixels) {
+		int nPixels = std::min(narrowTilePixels, width - x0);
+		__m256 acc[NOUT][narrowTilePixels];
+		for (int op = 0; op < NOUT; op++) {
+			for (int x = 0; x < narrowTilePixels; x++) {
+				acc[op][x] = _mm256_setzero_ps();
+			}
+		}
+
+		if (nPixels == narrowTilePixels) {
+			accumulateNarrowAVX2<NIN, NOUT>(inputRows, weights, x0, acc,
+					narrowTilePixels);
+		} else {
+			accumulateNarrowAVX2<NIN, NOUT>(inputRows, weights, x0, acc,
+					nPixels);
+		}
+
+		// padding of the block is written as zero
+		float *out = outputRow + x0 * C;
+		for (int x = 0; x < nPixels; x++) {
+			alignas(32) float v[weightBlockSize] = { };
+			for (int op = 0; op < NOUT; op++) {
+				float s = horizontalSum(acc[op][x]) + biases[op];
+				v[op] = s > 0.0f ? s : s * 0.1f;
+			}
+			_mm256_storeu_ps(out + x * C, _mm256_load_ps(v));
+		}
+	} // for x0
+
+}
+
+// ===== selection =====
+
+template<int NIN, int NOUT>
+static void filterRow3x3Specialized(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width) {
+
+	CpuFeatureLevel level = getCpuFeatureLevel();
+	if (level < CpuFeatureLevel::AVX2) {
+		filterRow3x3Packed(inputRows, nInputPlanes, weights, beginningBlock,
+				nBlocks, outputRows, width);
+		return;
+	}
+
+	if (NOUT < weightBlockSize) {
+		// single block
+		filterRowNarrowAVX2<NIN, (NOUT < weightBlockSize ? NOUT : 1)>(
+				inputRows, weights, outputRows[0], width);
+		return;
+	}
+
+	int i = 0;
+	if (level >= CpuFeatureLevel::AVX512) {
+		for (; i + 2 <= nBlocks; i += 2) {
+			int b = beginningBlock + i;
+			filterRowBlockPairSpecializedAVX512<NIN>(inputRows,
+					weights.getBlockWeights(b), weights.getBlockWeights(b + 1),
+					weights.getBlockBiases(b), weights.getBlockBiases(b + 1),
+					outputRows[i], outputRows[i + 1], width);
+		}
+	}
+	// (AVX-512F CPUs have AVX2 and FMA)
+	for (; i < nBlocks; i++) {
+		int b = beginningBlock + i;
+		filterRowBlockSpecializedAVX2<NIN>(inputRows,
+				weights.getBlockWeights(b), weights.getBlockBiases(b),
+				outputRows[i], width);
+	}
+
+}
+
+struct FilterRowKernelEntry {
+	int nInputPlanes;
+	int nOutputPlanes;
+	int kernelSize;
+	FilterRowKernel kernel;
+};
+
+// layer shapes of waifu2x models (noise and scale2.0x)
+static const FilterRowKernelEntry filterRowKernels[] = {
+	{ 1, 32, 3, &filterRow3x3Specialized<1, 32> },
+	{ 32, 32, 3, &filterRow3x3Specialized<32, 32> },
+	{ 32, 64, 3, &filterRow3x3Specialized<32, 64> },
+	{ 64, 64, 3, &filterRow3x3Specialized<64, 64> },
+	{ 64, 128, 3, &filterRow3x3Specialized<64, 128> },
+	{ 128, 128, 3, &filterRow3x3Specialized<128, 128> },
+	{ 128, 1, 3, &filterRow3x3Specialized<128, 1> },
+};
+
+#endif /* W2XC_X86 */
+
+FilterRowKernel findFilterRowKernel(int nInputPlanes, int nOutputPlanes,
+		int kernelSize) {
+#ifdef W2XC_X86
+	for (auto&& entry : filterRowKernels) {
+		if (entry.nInputPlanes == nInputPlanes
+				&& entry.nOutputPlanes == nOutputPlanes
+				&& entry.kernelSize == kernelSize) {
+			return entry.kernel;
+		}
+	}
+#endif
+	return &filterRow3x3Packed;
+}
+
+}
@@ -0,0 +1,155 @@
+/*
+ * filterKernelsUniversal.cpp
+ *   implementation of filterRow3x3Packed() and biasLeakyReLU() on
+ *   universal intrinsics of OpenCV (opencv2/hal/intrin.hpp)
+ *
+ *   The same source is built with SSE2 on x86, NEON on ARM, and the
+ *   C++ emulation (intrin_cpp.hpp) elsewhere. Defining
+ *   W2XC_INTRIN_EMULATION forces the emulation, for comparing outputs of
+ *   the portable code on x86.
+ */
+
+#include "filterKernelsImpl.hpp"
+#include "activationTensor.hpp"
+#include <algorithm>
+
+#include "opencv2/hal/defs.h"
+#ifdef W2XC_INTRIN_EMULATION
+#undef CV_SSE2
+#define CV_SSE2 0
+#undef CV_NEON
+#define CV_NEON 0
+#endif
+#include "opencv2/hal/intrin.hpp"
+
+namespace w2xc {
+
+static constexpr int C = tensorChannelBlock;
+
+// one block is 2 registers (lower and upper 4 planes)
+static_assert(weightBlockSize == 8, "block must be 2 x v_float32x4");
+
+// number of output pixels accumulated at once
+// (2 accumulators per pixel, NEON on AArch64 has 32 registers, SSE 16)
+#if CV_NEON && defined(__aarch64__)
+static constexpr int tilePixelsUniversal = 12;
+#else
+static constexpr int tilePixelsUniversal = 6;
+#endif
+
+// (loads of the emulation are templates which can't deduce the lane count)
+static inline cv::v_float32x4 loadAligned(const float *ptr) {
+#if CV_SIMD128
+	return cv::v_load_aligned(ptr);
+#else
+	return cv::v_load_aligned<float, 4>(ptr);
+#endif
+}
+
+static inline cv::v_float32x4 load(const float *ptr) {
+#if CV_SIMD128
+	return cv::v_load(ptr);
+#else
+	return cv::v_load<float, 4>(ptr);
+#endif
+}
+
+// accumulate one input channel for nPixels pixels
+// rows : upper, center, lower row of the channel at pixel (x0 - 1)
+static inline void accumulateChannelUniversal(const float * const *rows,
+		const float *w, cv::v_float32x4 *lo, cv::v_float32x4 *hi,
+		int nPixels) {
+	for (int tap = 0; tap < 9; tap++) {
+		const float *row = rows[tap / 3] + (tap % 3) * C;
+		const cv::v_float32x4 wLo = loadAligned(w + tap * weightBlockSize);
+		const cv::v_float32x4 wHi = loadAligned(w + tap * weightBlockSize + 4);
+		for (int x = 0; x < nPixels; x++) {
+			const cv::v_float32x4 v = cv::v_setall_f32(row[x * C]);
+			lo[x] = cv::v_muladd(v, wLo, lo[x]);
+			hi[x] = cv::v_muladd(v, wHi, hi[x]);
+		}
+	}
+}
+
+// LeakyReLU(0.1) : max(v, 0.1 * v)
+static inline cv::v_float32x4 leakyReLUUniversal(const cv::v_float32x4 &v) {
+	return cv::v_max(v, v * cv::v_setall_f32(0.1f));
+}
+
+static void filterRowBlockUniversal(const float * const *inputRows,
+		int nInputPlanes, const float *blockWeights, const float *blockBiases,
+		float *outputRow, int width) {
+
+	const cv::v_float32x4 biasLo = loadAligned(blockBiases);
+	const cv::v_float32x4 biasHi = loadAligned(blockBiases + 4);
+
+	for (int x0 = 0; x0 < width; x0 += tilePixelsUniversal) {
+		int nPixels = std::min(tilePixelsUniversal, width - x0);
+		cv::v_float32x4 lo[tilePixelsUniversal], hi[tilePixelsUniversal];
+		for (int x = 0; x < tilePixelsUniversal; x++) {
+			lo[x] = cv::v_setzero_f32();
+			hi[x] = cv::v_setzero_f32();
+		}
+
+		for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+			// neighbour columns are in the halo at borders (no clamping)
+			const float *rows[3];
+			for (int k = 0; k < 3; k++) {
+				rows[k] = inputRows[(ipIndex / C) * 3 + k] + (x0 - 1) * C
+						+ ipIndex % C;
+			}
+			const float *w = blockWeights + ipIndex * 9 * weightBlockSize;
+			if (nPixels == tilePixelsUniversal) {
+				accumulateChannelUniversal(rows, w, lo, hi,
+						tilePixelsUniversal);
+			} else {
+				accumulateChannelUniversal(rows, w, lo, hi, nPixels);
+			}
+		} // for ipIndex
+
+		float *out = outputRow + x0 * C;
+		for (int x = 0; x < nPixels; x++) {
+			cv::v_store(out + x * C, leakyReLUUniversal(lo[x] + biasLo));
+			cv::v_store(out + x * C + 4, leakyReLUUniversal(hi[x] + biasHi));
+		}
+	} // for x0
+
+}
+
+void filterRow3x3PackedUniversal(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width) {
+	for (int i = 0; i < nBlocks; i++) {
+		filterRowBlockUniversal(inputRows, nInputPlanes,
+				weights.getBlockWeights(beginningBlock + i),
+				weights.getBlockBiases(beginningBlock + i), outputRows[i],
+				width);
+	}
+}
+
+void biasLeakyReLU(const float *inputRow, float bias, float *outputRow,
+		int width, int outputStride) {
+	const cv::v_float32x4 vBias = cv::v_setall_f32(bias);
+	int x = 0;
+
+	for (; x + 4 <= width; x += 4) {
+		cv::v_float32x4 v = leakyReLUUniversal(load(inputRow + x) + vBias);
+		if (outputStride == 1) {
+			cv::v_store(outputRow + x, v);
+		} else {
+			// scatter into blocked layout
+			float lanes[4];
+			cv::v_store(lanes, v);
+			for (int i = 0; i < 4; i++) {
+				outputRow[(x + i) * outputStride] = lanes[i];
+			}
+		}
+	}
+
+	for (; x < width; x++) {
+		float v = inputRow[x] + bias;
+		outputRow[x * outputStride] = std::max(v, v * 0.1f);
+	}
+}
+
+}
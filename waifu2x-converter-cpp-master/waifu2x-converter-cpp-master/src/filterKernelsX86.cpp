@@ -0,0 +1,255 @@
+/*
+ * filterKernelsX86.cpp
+ *   SSE4.1, AVX2 + FMA and AVX-512F implementations of filterRow3x3Packed()
+ *
+ *   Each function is compiled for its instruction set by target attribute,
+ *   so no compiler flag is required, and is called only when
+ *   getCpuFeatureLevel() allows it.
+ */
+
+#include "filterKernelsImpl.hpp"
+#include "activationTensor.hpp"
+
+#ifdef W2XC_X86
+
+#include <immintrin.h>
+#include <algorithm>
+
+namespace w2xc {
+
+static constexpr int C = tensorChannelBlock;
+
+// upper, center, lower row of channel ipIndex at pixel (x0 - 1)
+static inline void setChannelRows(const float * const *inputRows, int ipIndex,
+		int x0, const float *rows[3]) {
+	for (int k = 0; k < 3; k++) {
+		rows[k] = inputRows[(ipIndex / C) * 3 + k] + (x0 - 1) * C + ipIndex % C;
+	}
+}
+
+// ===== SSE4.1 : one block is 2 registers =====
+
+static constexpr int tilePixelsSSE41 = 6;
+
+W2XC_TARGET("sse4.1")
+static inline void accumulateChannelSSE41(const float * const *rows,
+		const float *w, __m128 *lo, __m128 *hi, int nPixels) {
+	for (int tap = 0; tap < 9; tap++) {
+		const float *row = rows[tap / 3] + (tap % 3) * C;
+		const __m128 wLo = _mm_load_ps(w + tap * weightBlockSize);
+		const __m128 wHi = _mm_load_ps(w + tap * weightBlockSize + 4);
+		for (int x = 0; x < nPixels; x++) {
+			const __m128 v = _mm_load1_ps(row + x * C);
+			lo[x] = _mm_add_ps(lo[x], _mm_mul_ps(v, wLo));
+			hi[x] = _mm_add_ps(hi[x], _mm_mul_ps(v, wHi));
+		}
+	}
+}
+
+W2XC_TARGET("sse4.1")
+static void filterRowBlockSSE41(const float * const *inputRows,
+		int nInputPlanes, const float *blockWeights, const float *blockBiases,
+		float *outputRow, int width) {
+
+	const __m128 biasLo = _mm_load_ps(blockBiases);
+	const __m128 biasHi = _mm_load_ps(blockBiases + 4);
+	const __m128 slope = _mm_set1_ps(0.1f);
+
+	for (int x0 = 0; x0 < width; x0 += tilePixelsSSE41) {
+		int nPixels = std::min(tilePixelsSSE41, width - x0);
+		__m128 lo[tilePixelsSSE41], hi[tilePixelsSSE41];
+		for (int x = 0; x < tilePixelsSSE41; x++) {
+			lo[x] = _mm_setzero_ps();
+			hi[x] = _mm_setzero_ps();
+		}
+
+		for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+			const float *rows[3];
+			setChannelRows(inputRows, ipIndex, x0, rows);
+			const float *w = blockWeights + ipIndex * 9 * weightBlockSize;
+			if (nPixels == tilePixelsSSE41) {
+				accumulateChannelSSE41(rows, w, lo, hi, tilePixelsSSE41);
+			} else {
+				accumulateChannelSSE41(rows, w, lo, hi, nPixels);
+			}
+		}
+
+		// LeakyReLU(0.1) : max(v, 0.1 * v)
+		float *out = outputRow + x0 * C;
+		for (int x = 0; x < nPixels; x++) {
+			__m128 vLo = _mm_add_ps(lo[x], biasLo);
+			__m128 vHi = _mm_add_ps(hi[x], biasHi);
+			_mm_storeu_ps(out + x * C, _mm_max_ps(vLo, _mm_mul_ps(vLo, slope)));
+			_mm_storeu_ps(out + x * C + 4,
+					_mm_max_ps(vHi, _mm_mul_ps(vHi, slope)));
+		}
+	} // for x0
+
+}
+
+void filterRow3x3PackedSSE41(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width) {
+	for (int i = 0; i < nBlocks; i++) {
+		filterRowBlockSSE41(inputRows, nInputPlanes,
+				weights.getBlockWeights(beginningBlock + i),
+				weights.getBlockBiases(beginningBlock + i), outputRows[i],
+				width);
+	}
+}
+
+// ===== AVX2 + FMA : one block is 1 register =====
+
+static constexpr int tilePixelsAVX2 = 12;
+
+W2XC_TARGET("avx2,fma")
+static inline void accumulateChannelAVX2(const float * const *rows,
+		const float *w, __m256 *acc, int nPixels) {
+	for (int tap = 0; tap < 9; tap++) {
+		const float *row = rows[tap / 3] + (tap % 3) * C;
+		const __m256 wt = _mm256_load_ps(w + tap * weightBlockSize);
+		for (int x = 0; x < nPixels; x++) {
+			acc[x] = _mm256_fmadd_ps(_mm256_broadcast_ss(row + x * C), wt,
+					acc[x]);
+		}
+	}
+}
+
+W2XC_TARGET("avx2,fma")
+static void filterRowBlockAVX2(const float * const *inputRows,
+		int nInputPlanes, const float *blockWeights, const float *blockBiases,
+		float *outputRow, int width) {
+
+	const __m256 bias = _mm256_load_ps(blockBiases);
+	const __m256 slope = _mm256_set1_ps(0.1f);
+
+	for (int x0 = 0; x0 < width; x0 += tilePixelsAVX2) {
+		int nPixels = std::min(tilePixelsAVX2, width - x0);
+		__m256 acc[tilePixelsAVX2];
+		for (int x = 0; x < tilePixelsAVX2; x++) {
+			acc[x] = _mm256_setzero_ps();
+		}
+
+		for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+			const float *rows[3];
+			setChannelRows(inputRows, ipIndex, x0, rows);
+			const float *w = blockWeights + ipIndex * 9 * weightBlockSize;
+			if (nPixels == tilePixelsAVX2) {
+				accumulateChannelAVX2(rows, w, acc, tilePixelsAVX2);
+			} else {
+				accumulateChannelAVX2(rows, w, acc, nPixels);
+			}
+		}
+
+		float *out = outputRow + x0 * C;
+		for (int x = 0; x < nPixels; x++) {
+			__m256 v = _mm256_add_ps(acc[x], bias);
+			_mm256_storeu_ps(out + x * C,
+					_mm256_max_ps(v, _mm256_mul_ps(v, slope)));
+		}
+	} // for x0
+
+}
+
+void filterRow3x3PackedAVX2(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width) {
+	for (int i = 0; i < nBlocks; i++) {
+		filterRowBlockAVX2(inputRows, nInputPlanes,
+				weights.getBlockWeights(beginningBlock + i),
+				weights.getBlockBiases(beginningBlock + i), outputRows[i],
+				width);
+	}
+}
+
+// ===== AVX-512F : two blocks are 1 register =====
+// (lower half : block b, upper half : block b + 1,
+//  so that one broadcast input pixel feeds 16 output planes)
+
+static constexpr int tilePixelsAVX512 = 16;
+
+W2XC_TARGET("avx512f")
+static inline __m512 combineBlocks(__m256 lower, __m256 upper) {
+	return _mm512_castpd_ps(
+			_mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(lower)),
+					_mm256_castps_pd(upper), 1));
+}
+
+W2XC_TARGET("avx512f")
+static inline void accumulateChannelAVX512(const float * const *rows,
+		const float *w0, const float *w1, __m512 *acc, int nPixels) {
+	for (int tap = 0; tap < 9; tap++) {
+		const float *row = rows[tap / 3] + (tap % 3) * C;
+		const __m512 wt = combineBlocks(
+				_mm256_load_ps(w0 + tap * weightBlockSize),
+				_mm256_load_ps(w1 + tap * weightBlockSize));
+		for (int x = 0; x < nPixels; x++) {
+			acc[x] = _mm512_fmadd_ps(_mm512_set1_ps(row[x * C]), wt, acc[x]);
+		}
+	}
+}
+
+W2XC_TARGET("avx512f")
+static void filterRowBlockPairAVX512(const float * const *inputRows,
+		int nInputPlanes, const float *weights0, const float *weights1,
+		const float *biases0, const float *biases1, float *outputRow0,
+		float *outputRow1, int width) {
+
+	const __m512 bias = combineBlocks(_mm256_load_ps(biases0),
+			_mm256_load_ps(biases1));
+	const __m512 slope = _mm512_set1_ps(0.1f);
+
+	for (int x0 = 0; x0 < width; x0 += tilePixelsAVX512) {
+		int nPixels = std::min(tilePixelsAVX512, width - x0);
+		__m512 acc[tilePixelsAVX512];
+		for (int x = 0; x < tilePixelsAVX512; x++) {
+			acc[x] = _mm512_setzero_ps();
+		}
+
+		for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+			const float *rows[3];
+			setChannelRows(inputRows, ipIndex, x0, rows);
+			const float *w0 = weights0 + ipIndex * 9 * weightBlockSize;
+			const float *w1 = weights1 + ipIndex * 9 * weightBlockSize;
+			if (nPixels == tilePixelsAVX512) {
+				accumulateChannelAVX512(rows, w0, w1, acc, tilePixelsAVX512);
+			} else {
+				accumulateChannelAVX512(rows, w0, w1, acc, nPixels);
+			}
+		}
+
+		float *out0 = outputRow0 + x0 * C;
+		float *out1 = outputRow1 + x0 * C;
+		for (int x = 0; x < nPixels; x++) {
+			__m512 v = _mm512_add_ps(acc[x], bias);
+			v = _mm512_max_ps(v, _mm512_mul_ps(v, slope));
+			_mm256_storeu_ps(out0 + x * C, _mm512_castps512_ps256(v));
+			_mm256_storeu_ps(out1 + x * C,
+					_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v),
+							1)));
+		}
+	} // for x0
+
+}
+
+void filterRow3x3PackedAVX512(const float * const *inputRows,
+		int nInputPlanes, const PackedWeights &weights, int beginningBlock,
+		int nBlocks, float * const *outputRows, int width) {
+	int i = 0;
+	for (; i + 2 <= nBlocks; i += 2) {
+		int b = beginningBlock + i;
+		filterRowBlockPairAVX512(inputRows, nInputPlanes,
+				weights.getBlockWeights(b), weights.getBlockWeights(b + 1),
+				weights.getBlockBiases(b), weights.getBlockBiases(b + 1),
+				outputRows[i], outputRows[i + 1], width);
+	}
+	// remaining single block (AVX-512F CPUs have AVX2 and FMA)
+	if (i < nBlocks) {
+		filterRow3x3PackedAVX2(inputRows, nInputPlanes, weights,
+				beginningBlock + i, 1, outputRows + i, width);
+	}
+}
+
+}
+
+#endif /* W2XC_X86 */
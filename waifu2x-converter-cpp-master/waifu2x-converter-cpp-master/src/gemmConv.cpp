@@ -0,0 +1,121 @@
+/*
+ * gemmConv.cpp
+ *   im2col + blocked SGEMM convolution backend
+ */
+
+#include "gemmConv.hpp"
+#include <algorithm>
+
+namespace w2xc {
+
+// cache blocking of SGEMM
+// (blockK x blockN panel of B stays in L2, microM x microN tile of C in registers)
+static constexpr int blockK = 256;
+static constexpr int blockN = 128;
+static constexpr int microM = 4;
+static constexpr int microN = 16;
+
+void im2colRow3x3(const float * const *inputRows, int nInputPlanes, int width,
+		int pixelStride, float *patches, int ldPatches) {
+
+	for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+		for (int r = 0; r < 3; r++) {
+			const float *row = inputRows[ipIndex * 3 + r];
+			float *left = patches + (ipIndex * 9 + r * 3 + 0) * ldPatches;
+			float *center = patches + (ipIndex * 9 + r * 3 + 1) * ldPatches;
+			float *right = patches + (ipIndex * 9 + r * 3 + 2) * ldPatches;
+
+			for (int x = 0; x < width; x++) {
+				center[x] = row[x * pixelStride];
+			}
+			if (width > 1) {
+				std::copy(center, center + width - 1, left + 1);
+				std::copy(center + 1, center + width, right);
+			}
+			// replicated borders
+			left[0] = center[0];
+			right[width - 1] = center[width - 1];
+		}
+	}
+
+}
+
+// C(microM x microN) += A(microM x kc) * B(kc x microN)  (microM is 4)
+static inline void microKernel(int kc, const float *A, int lda, const float *B,
+		int ldb, float *C, int ldc) {
+
+	float c0[microN] = { }, c1[microN] = { }, c2[microN] = { }, c3[microN] = { };
+	const float *a0 = A, *a1 = A + lda, *a2 = A + 2 * lda, *a3 = A + 3 * lda;
+
+	for (int k = 0; k < kc; k++) {
+		const float *b = B + k * ldb;
+		const float va0 = a0[k], va1 = a1[k], va2 = a2[k], va3 = a3[k];
+		for (int j = 0; j < microN; j++) {
+			const float vb = b[j];
+			c0[j] += va0 * vb;
+			c1[j] += va1 * vb;
+			c2[j] += va2 * vb;
+			c3[j] += va3 * vb;
+		}
+	}
+
+	for (int j = 0; j < microN; j++) {
+		C[0 * ldc + j] += c0[j];
+		C[1 * ldc + j] += c1[j];
+		C[2 * ldc + j] += c2[j];
+		C[3 * ldc + j] += c3[j];
+	}
+}
+
+// same as microKernel(), for partial tiles at the edge of C
+static void microKernelEdge(int mr, int nr, int kc, const float *A, int lda,
+		const float *B, int ldb, float *C, int ldc) {
+
+	for (int i = 0; i < mr; i++) {
+		for (int k = 0; k < kc; k++) {
+			const float a = A[i * lda + k];
+			const float *b = B + k * ldb;
+			for (int j = 0; j < nr; j++) {
+				C[i * ldc + j] += a * b[j];
+			}
+		}
+	}
+}
+
+void sgemmBlocked(int M, int N, int K, const float *A, int lda,
+		const float *B, int ldb, float *C, int ldc) {
+
+	for (int m = 0; m < M; m++) {
+		std::fill(C + m * ldc, C + m * ldc + N, 0.0f);
+	}
+
+	for (int k0 = 0; k0 < K; k0 += blockK) {
+		int kc = std::min(blockK, K - k0);
+
+		for (int n0 = 0; n0 < N; n0 += blockN) {
+			int nc = std::min(blockN, N - n0);
+
+			for (int m0 = 0; m0 < M; m0 += microM) {
+				int mr = std::min(microM, M - m0);
+				const float *a = A + m0 * lda + k0;
+
+				for (int n1 = n0; n1 < n0 + nc; n1 += microN) {
+					int nr = std::min(microN, n0 + nc - n1);
+					const float *b = B + k0 * ldb + n1;
+					float *c = C + m0 * ldc + n1;
+
+					if (mr == microM && nr == microN) {
+						microKernel(kc, a, lda, b, ldb, c, ldc);
+					} else {
+						microKernelEdge(mr, nr, kc, a, lda, b, ldb, c, ldc);
+					}
+				}
+			}
+
+		} // for n0
+
+	} // for k0
+
+}
+
+}
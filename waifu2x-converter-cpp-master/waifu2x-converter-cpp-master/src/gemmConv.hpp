@@ -0,0 +1,40 @@
+/*
+ * gemmConv.hpp
+ *   im2col + blocked SGEMM convolution backend
+ *
+ *   A 3x3 layer is lowered to
+ *     output(nOutputPlanes x pixels)
+ *       = weight(nOutputPlanes x 9*nInputPlanes) * patches(9*nInputPlanes x pixels)
+ */
+
+#ifndef GEMM_CONV_HPP_
+#define GEMM_CONV_HPP_
+
+namespace w2xc {
+
+/**
+ * write the 3x3 patches of one row into column block of patch matrix.
+ * patch matrix row (ipIndex * 9 + r * 3 + c) holds tap (r, c) of input plane
+ * ipIndex, and column x holds pixel x of this row.
+ *
+ * inputRows   : 3 row pointers (upper, center, lower) per input plane,
+ *               inputRows[ipIndex * 3 + 0..2]
+ * pixelStride : distance between pixels of input rows (in floats)
+ * patches     : pointer to column 0 of this row in the patch matrix
+ * ldPatches   : row stride of the patch matrix (in elements)
+ *
+ * columns outside of the row are replicated (same as cv::BORDER_REPLICATE).
+ */
+void im2colRow3x3(const float * const *inputRows, int nInputPlanes, int width,
+		int pixelStride, float *patches, int ldPatches);
+
+/**
+ * C(M x N) = A(M x K) * B(K x N), all row-major.
+ * cache-blocked, single threaded (callers split N across threads).
+ */
+void sgemmBlocked(int M, int N, int K, const float *A, int lda,
+		const float *B, int ldb, float *C, int ldc);
+
+}
+
+#endif /* GEMM_CONV_HPP_ */
@@ -0,0 +1,143 @@
+/*
+ * halfFloat.cpp
+ *   conversion between float and IEEE 754 half (binary16)
+ */
+
+#include "halfFloat.hpp"
+#include "cpuFeatures.hpp"
+#include <cstring>
+
+#ifdef W2XC_X86
+#include <immintrin.h>
+#endif
+
+namespace w2xc {
+
+static uint16_t floatToHalf(float value) {
+	uint32_t f;
+	std::memcpy(&f, &value, sizeof(f));
+
+	uint32_t sign = (f >> 16) & 0x8000;
+	uint32_t floatExponent = (f >> 23) & 0xff;
+	uint32_t mantissa = f & 0x7fffff;
+	int exponent = static_cast<int>(floatExponent) - 127 + 15;
+
+	if (floatExponent == 0xff) {
+		// infinity or NaN (NaN is quieted and keeps upper bits of payload,
+		// same as F16C)
+		if (mantissa != 0) {
+			return static_cast<uint16_t>(sign | 0x7e00 | (mantissa >> 13));
+		}
+		return static_cast<uint16_t>(sign | 0x7c00);
+	}
+	if (exponent >= 31) {
+		return static_cast<uint16_t>(sign | 0x7c00);
+	}
+
+	uint32_t half;
+	int shift;
+	if (exponent <= 0) {
+		// subnormal half (or zero)
+		if (exponent < -10) {
+			return static_cast<uint16_t>(sign);
+		}
+		mantissa |= 0x800000;
+		shift = 14 - exponent;
+		half = mantissa >> shift;
+	} else {
+		shift = 13;
+		half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> shift);
+	}
+
+	// round to nearest even (carry into exponent is correct, up to infinity)
+	uint32_t remainder = mantissa & ((1u << shift) - 1);
+	uint32_t halfway = 1u << (shift - 1);
+	if (remainder > halfway || (remainder == halfway && (half & 1))) {
+		half++;
+	}
+	return static_cast<uint16_t>(sign | half);
+}
+
+static float halfToFloat(uint16_t value) {
+	uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+	int exponent = (value >> 10) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+
+	uint32_t f;
+	if (exponent == 0x1f) {
+		// infinity or NaN (quieted, same as F16C)
+		f = sign | 0x7f800000 | ((mantissa ? (mantissa | 0x200) : 0) << 13);
+	} else if (exponent != 0) {
+		f = sign | (static_cast<uint32_t>(exponent + 127 - 15) << 23)
+				| (mantissa << 13);
+	} else if (mantissa == 0) {
+		f = sign;
+	} else {
+		// subnormal half is normal float
+		exponent = 1;
+		while (!(mantissa & 0x400)) {
+			mantissa <<= 1;
+			exponent--;
+		}
+		mantissa &= 0x3ff;
+		f = sign | (static_cast<uint32_t>(exponent + 127 - 15) << 23)
+				| (mantissa << 13);
+	}
+
+	float result;
+	std::memcpy(&result, &f, sizeof(result));
+	return result;
+}
+
+#ifdef W2XC_X86
+
+W2XC_TARGET("avx,f16c")
+static int convertFloatToHalfF16C(const float *src, uint16_t *dst, int n) {
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+				_mm256_cvtps_ph(_mm256_loadu_ps(src + i),
+						_MM_FROUND_TO_NEAREST_INT));
+	}
+	return i;
+}
+
+W2XC_TARGET("avx,f16c")
+static int convertHalfToFloatF16C(const uint16_t *src, float *dst, int n) {
+	int i = 0;
+	for (; i + 8 <= n; i += 8) {
+		_mm256_storeu_ps(dst + i,
+				_mm256_cvtph_ps(
+						_mm_loadu_si128(
+								reinterpret_cast<const __m128i *>(src + i))));
+	}
+	return i;
+}
+
+#endif
+
+void convertFloatToHalf(const float *src, uint16_t *dst, int n) {
+	int i = 0;
+#ifdef W2XC_X86
+	if (getCpuFeatureLevel() >= CpuFeatureLevel::AVX2) {
+		i = convertFloatToHalfF16C(src, dst, n);
+	}
+#endif
+	for (; i < n; i++) {
+		dst[i] = floatToHalf(src[i]);
+	}
+}
+
+void convertHalfToFloat(const uint16_t *src, float *dst, int n) {
+	int i = 0;
+#ifdef W2XC_X86
+	if (getCpuFeatureLevel() >= CpuFeatureLevel::AVX2) {
+		i = convertHalfToFloatF16C(src, dst, n);
+	}
+#endif
+	for (; i < n; i++) {
+		dst[i] = halfToFloat(src[i]);
+	}
+}
+
+}
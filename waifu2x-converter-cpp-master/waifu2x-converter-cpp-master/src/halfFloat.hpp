@@ -0,0 +1,21 @@
+/*
+ * halfFloat.hpp
+ *   conversion between float and IEEE 754 half (binary16)
+ *
+ *   F16C is used on AVX2 level (see cpuFeatures.hpp), scalar conversion
+ *   otherwise. Both round to nearest even, so results are the same.
+ */
+
+#ifndef HALF_FLOAT_HPP_
+#define HALF_FLOAT_HPP_
+
+#include <cstdint>
+
+namespace w2xc {
+
+void convertFloatToHalf(const float *src, uint16_t *dst, int n);
+void convertHalfToFloat(const uint16_t *src, float *dst, int n);
+
+}
+
+#endif /* HALF_FLOAT_HPP_ */
@@ -0,0 +1,355 @@
+/*
+ * imageConversion.cpp
+ *   conversion of one image by models loaded beforehand
+ */
+
+#include "imageConversion.hpp"
+#include "convertRoutine.hpp"
+#include "colorConversion.hpp"
+#include "errorReport.hpp"
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+namespace w2xc {
+
+bool isValidConversionSettings(const ConversionSettings &settings) {
+	return (settings.mode == "noise" || settings.mode == "scale"
+			|| settings.mode == "noise_scale")
+			&& (settings.noiseLevel == 1 || settings.noiseLevel == 2)
+			&& settings.scaleRatio > 0.0;
+}
+
+// context with tuned block size of models (if any)
+static ExecutionContext getModelContext(const ExecutionContext &context,
+		cv::Size tunedBlockSize) {
+	ExecutionContext modelContext = context;
+	if (tunedBlockSize.area() > 0)
+		modelContext.blockSize = tunedBlockSize;
+	return modelContext;
+}
+
+bool convertImage(PlanarImage &image, const ConversionSettings &settings,
+		ConversionModels &models, const ExecutionContext &context) {
+
+	if (!isValidConversionSettings(settings)) {
+		reportError("invalid conversion settings");
+		return false;
+	}
+	bool noise = (settings.mode == "noise" || settings.mode == "noise_scale");
+	bool scale = (settings.mode == "scale" || settings.mode == "noise_scale");
+	std::vector<std::unique_ptr<Model> > &noiseModels =
+			models.noise[settings.noiseLevel - 1];
+	std::vector<std::unique_ptr<Model> > &scaleModels = models.scale;
+	if ((noise && noiseModels.empty()) || (scale && scaleModels.empty())) {
+		reportError("models of " + settings.mode + " are not loaded");
+		return false;
+	}
+
+	// ===== Noise Reduction Phase =====
+	if (noise) {
+		cv::Mat imageY;
+		if (!convertWithModels(image.y, imageY, noiseModels,
+				getModelContext(context,
+						models.noiseBlockSize[settings.noiseLevel - 1])))
+			return false;
+		image.y = imageY;
+
+	} // noise reduction phase : end
+
+	// ===== scaling phase =====
+
+	if (scale) {
+
+		// calculate iteration times of 2x scaling and shrink ratio which will use at last
+		int iterTimesTwiceScaling = static_cast<int>(std::ceil(
+				std::log2(settings.scaleRatio)));
+		double shrinkRatio = 0.0;
+		if (static_cast<int>(settings.scaleRatio)
+				!= std::pow(2, iterTimesTwiceScaling)) {
+			shrinkRatio = settings.scaleRatio
+					/ std::pow(2.0, static_cast<double>(iterTimesTwiceScaling));
+		}
+
+		ExecutionContext scaleContext = getModelContext(context,
+				models.scaleBlockSize);
+
+		if (context.verbose)
+			std::cout << "start scaling" << std::endl;
+
+		// 2x scaling
+		for (int nIteration = 0; nIteration < iterTimesTwiceScaling;
+				nIteration++) {
+
+			if (context.verbose) {
+				std::cout << "#" << std::to_string(nIteration + 1)
+						<< " 2x scaling..." << std::endl;
+			}
+
+			cv::Size imageSize = image.y.size();
+			imageSize.width *= 2;
+			imageSize.height *= 2;
+
+			// Y is upscaled (nearest-neighbour) inside the first layer
+			cv::Mat imageY;
+			if(!convertWithModelsUpsampled2x(image.y, imageY, scaleModels,
+					scaleContext)){
+				reportError("convertWithModels : something error has occured.");
+				return false;
+			};
+			image.y = imageY;
+
+			// chroma is scaled by bicubic interpolation
+			if (!image.isGray()) {
+				cv::resize(image.u, image.u, imageSize, 0, 0, cv::INTER_CUBIC);
+				cv::resize(image.v, image.v, imageSize, 0, 0, cv::INTER_CUBIC);
+			}
+
+		} // 2x scaling : end
+
+		// planes are shrunk while encoding (see toBGRImage())
+		image.outputSize = image.y.size();
+		if (shrinkRatio != 0.0) {
+			image.outputSize.width =
+					static_cast<int>(static_cast<double>(image.outputSize.width
+							* shrinkRatio));
+			image.outputSize.height =
+					static_cast<int>(static_cast<double>(image.outputSize.height
+							* shrinkRatio));
+		}
+
+	}
+
+	return true;
+}
+
+std::string getAutoOutputFileName(const std::string &inputFileName,
+		const ConversionSettings &settings) {
+	std::string outputFileName = inputFileName;
+	std::string::size_type tailDot = outputFileName.find_last_of('.');
+	if (tailDot != std::string::npos
+			&& tailDot > outputFileName.find_last_of("/\\") + 1) {
+		outputFileName.erase(tailDot, outputFileName.length());
+	}
+	outputFileName = outputFileName + "(" + settings.mode + ")";
+	if(settings.mode.find("noise") != std::string::npos){
+		outputFileName = outputFileName + "(Level"
+				+ std::to_string(settings.noiseLevel) + ")";
+	}
+	if(settings.mode.find("scale") != std::string::npos){
+		outputFileName = outputFileName + "(x"
+				+ std::to_string(settings.scaleRatio) + ")";
+	}
+	outputFileName += ".png";
+	return outputFileName;
+}
+
+// B = G = R in all pixels of 8-bit BGR image
+// (stops at first colour pixel, so that colour images are not read twice)
+static bool isGrayImage(const cv::Mat &bgrImage) {
+	for (int y = 0; y < bgrImage.rows; y++) {
+		const unsigned char *row = bgrImage.ptr<unsigned char>(y);
+		for (int x = 0; x < bgrImage.cols; x++) {
+			if (row[x * 3] != row[x * 3 + 1] || row[x * 3] != row[x * 3 + 2])
+				return false;
+		}
+	}
+	return true;
+}
+
+// rows converted by a task of toPlanarImage()
+static constexpr int rowsPerConversionTask = 16;
+
+void toPlanarImage(const cv::Mat &bgrImage, PlanarImage &image,
+		ThreadPool *pool) {
+	image.release();
+	image.outputSize = bgrImage.size();
+	image.y.create(bgrImage.size(), CV_32FC1);
+	bool gray = isGrayImage(bgrImage);
+	if (!gray) {
+		image.u.create(bgrImage.size(), CV_32FC1);
+		image.v.create(bgrImage.size(), CV_32FC1);
+	}
+
+	int nTasks = (bgrImage.rows + rowsPerConversionTask - 1)
+			/ rowsPerConversionTask;
+	auto task = [&](int idx) {
+		int endRow = std::min((idx + 1) * rowsPerConversionTask,
+				bgrImage.rows);
+		for (int y = idx * rowsPerConversionTask; y < endRow; y++) {
+			convertBGRToYUV(bgrImage.ptr<unsigned char>(y),
+					image.y.ptr<float>(y),
+					gray ? nullptr : image.u.ptr<float>(y),
+					gray ? nullptr : image.v.ptr<float>(y), bgrImage.cols);
+		}
+	};
+	if (pool != nullptr) {
+		pool->parallelFor(nTasks, task);
+	} else {
+		for (int idx = 0; idx < nTasks; idx++)
+			task(idx);
+	}
+}
+
+// source pixels and weight of the second one, for each pixel of a line
+// shrunk from srcLength to dstLength by bilinear interpolation
+// (same coordinates as cv::resize() with INTER_LINEAR)
+struct BilinearTaps {
+	std::vector<int> first;
+	std::vector<int> second;
+	std::vector<float> weight;
+
+	BilinearTaps(int srcLength, int dstLength) :
+			first(dstLength), second(dstLength), weight(dstLength) {
+		double scale = static_cast<double>(srcLength) / dstLength;
+		for (int i = 0; i < dstLength; i++) {
+			double position = (i + 0.5) * scale - 0.5;
+			int index = static_cast<int>(std::floor(position));
+			float w = static_cast<float>(position - index);
+			if (index < 0) {
+				index = 0;
+				w = 0.0f;
+			}
+			if (index >= srcLength - 1) {
+				index = srcLength - 1;
+				w = 0.0f;
+			}
+			first[i] = index;
+			second[i] = std::min(index + 1, srcLength - 1);
+			weight[i] = w;
+		}
+	}
+};
+
+// row of plane interpolated from rows top and bottom of plane
+// (source pixels of Y are clamped to [0, 1] as the model output is)
+static void interpolateRow(const cv::Mat &plane, int top, int bottom,
+		float weightY, const BilinearTaps &columns, bool clamp,
+		float *row) {
+	const float *topRow = plane.ptr<float>(top);
+	const float *bottomRow = plane.ptr<float>(bottom);
+	auto pixel = [clamp](float value) {
+		return clamp ? std::min(std::max(value, 0.0f), 1.0f) : value;
+	};
+	for (std::size_t x = 0; x < columns.first.size(); x++) {
+		int x0 = columns.first[x], x1 = columns.second[x];
+		float weightX = columns.weight[x];
+		float upper = pixel(topRow[x0])
+				+ (pixel(topRow[x1]) - pixel(topRow[x0])) * weightX;
+		float lower = pixel(bottomRow[x0])
+				+ (pixel(bottomRow[x1]) - pixel(bottomRow[x0])) * weightX;
+		row[x] = upper + (lower - upper) * weightY;
+	}
+}
+
+void toBGRImage(const PlanarImage &image, cv::Mat &bgrImage,
+		ThreadPool *pool) {
+	cv::Size outputSize = image.outputSize;
+	bool gray = image.isGray();
+	bgrImage.create(outputSize, gray ? CV_8UC1 : CV_8UC3);
+
+	bool shrink = !(outputSize == image.y.size());
+	BilinearTaps columns(image.y.cols, shrink ? outputSize.width : 0);
+	BilinearTaps rows(image.y.rows, shrink ? outputSize.height : 0);
+
+	int nTasks = (outputSize.height + rowsPerConversionTask - 1)
+			/ rowsPerConversionTask;
+	auto task = [&](int idx) {
+		// shrunk rows of a task
+		std::vector<float> shrunkRows(shrink ? outputSize.width * 3 : 0);
+		float *shrunkY = shrunkRows.data();
+		float *shrunkU = shrunkY + outputSize.width;
+		float *shrunkV = shrunkU + outputSize.width;
+
+		int endRow = std::min((idx + 1) * rowsPerConversionTask,
+				outputSize.height);
+		for (int y = idx * rowsPerConversionTask; y < endRow; y++) {
+			if (!shrink) {
+				convertYUVToBGR(image.y.ptr<float>(y),
+						gray ? nullptr : image.u.ptr<float>(y),
+						gray ? nullptr : image.v.ptr<float>(y),
+						bgrImage.ptr<unsigned char>(y), outputSize.width);
+				continue;
+			}
+			int top = rows.first[y], bottom = rows.second[y];
+			float weightY = rows.weight[y];
+			interpolateRow(image.y, top, bottom, weightY, columns, true,
+					shrunkY);
+			if (!gray) {
+				interpolateRow(image.u, top, bottom, weightY, columns, false,
+						shrunkU);
+				interpolateRow(image.v, top, bottom, weightY, columns, false,
+						shrunkV);
+			}
+			convertYUVToBGR(shrunkY, gray ? nullptr : shrunkU,
+					gray ? nullptr : shrunkV, bgrImage.ptr<unsigned char>(y),
+					outputSize.width);
+		}
+	};
+	if (pool != nullptr) {
+		pool->parallelFor(nTasks, task);
+	} else {
+		for (int idx = 0; idx < nTasks; idx++)
+			task(idx);
+	}
+}
+
+bool decodeImage(const std::string &inputFileName, PlanarImage &image,
+		ThreadPool *pool) {
+	try {
+		cv::Mat bgrImage = cv::imread(inputFileName, cv::IMREAD_COLOR);
+		if (bgrImage.empty()) {
+			reportError("couldn't read image " + inputFileName);
+			image.release();
+			return false;
+		}
+		toPlanarImage(bgrImage, image, pool);
+	} catch (std::exception &e) {
+		reportError(inputFileName + " : " + e.what());
+		image.release();
+		return false;
+	}
+	return true;
+}
+
+bool decodeImage(const std::vector<unsigned char> &data,
+		PlanarImage &image, ThreadPool *pool) {
+	try {
+		cv::Mat bgrImage;
+		if (!data.empty()) {
+			bgrImage = cv::imdecode(
+					cv::Mat(1, static_cast<int>(data.size()), CV_8UC1,
+							const_cast<unsigned char *>(data.data())),
+					cv::IMREAD_COLOR);
+		}
+		if (bgrImage.empty()) {
+			reportError("couldn't decode image data");
+			image.release();
+			return false;
+		}
+		toPlanarImage(bgrImage, image, pool);
+	} catch (std::exception &e) {
+		reportError(std::string("image data : ") + e.what());
+		image.release();
+		return false;
+	}
+	return true;
+}
+
+bool encodeImage(const PlanarImage &image,
+		const std::string &outputFileName, ThreadPool *pool) {
+	try {
+		cv::Mat bgrImage;
+		toBGRImage(image, bgrImage, pool);
+		if (!cv::imwrite(outputFileName, bgrImage)) {
+			reportError("couldn't write " + outputFileName);
+			return false;
+		}
+	} catch (std::exception &e) {
+		reportError(outputFileName + " : " + e.what());
+		return false;
+	}
+	return true;
+}
+
+}
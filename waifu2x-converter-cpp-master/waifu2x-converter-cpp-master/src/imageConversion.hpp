@@ -0,0 +1,116 @@
+/*
+ * imageConversion.hpp
+ *   conversion of one image by models loaded beforehand
+ *   (shared by command line conversion and daemon mode)
+ */
+
+#ifndef IMAGE_CONVERSION_HPP_
+#define IMAGE_CONVERSION_HPP_
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include <memory>
+#include "modelHandler.hpp"
+
+namespace w2xc {
+
+// settings of conversion of an image
+struct ConversionSettings {
+	std::string mode; // "noise", "scale" or "noise_scale"
+	int noiseLevel; // 1 or 2
+	double scaleRatio;
+};
+
+/**
+ * models loaded once and used by conversions.
+ * models are not modified by conversion, so that concurrent conversions
+ * can share them.
+ * (models which are not used by the mode of conversion can be empty)
+ * block sizes are tuned block sizes of the models (see autotune.hpp),
+ * which are used instead of block size of execution context
+ * (empty : not tuned).
+ */
+struct ConversionModels {
+	std::vector<std::unique_ptr<Model> > noise[2]; // noise level 1 and 2
+	std::vector<std::unique_ptr<Model> > scale;
+	cv::Size noiseBlockSize[2];
+	cv::Size scaleBlockSize;
+};
+
+/**
+ * image as separate planes of YUV (CV_32FC1), kept from decoding to
+ * encoding, so that only Y goes through models and only U and V are
+ * resized by bicubic interpolation.
+ * u and v are empty for grayscale image (chroma is 0.5 everywhere).
+ * outputSize is the size of encoded image. planes larger than it (scale
+ * ratio which is not a power of 2) are shrunk while encoding, by
+ * bilinear interpolation.
+ */
+struct PlanarImage {
+	cv::Mat y;
+	cv::Mat u;
+	cv::Mat v;
+	cv::Size outputSize;
+
+	bool empty() const {
+		return y.empty();
+	}
+	bool isGray() const {
+		return u.empty();
+	}
+	void release() {
+		y.release();
+		u.release();
+		v.release();
+		outputSize = cv::Size();
+	}
+};
+
+bool isValidConversionSettings(const ConversionSettings &settings);
+
+/**
+ * convert one image on thread pool and settings of context (see
+ * convertWithModels()).
+ * returns false if models of the settings are not loaded, or conversion
+ * by models failed.
+ */
+bool convertImage(PlanarImage &image, const ConversionSettings &settings,
+		ConversionModels &models, const ExecutionContext &context);
+
+// "<input without extension>(mode)(LevelN)(xR).png"
+std::string getAutoOutputFileName(const std::string &inputFileName,
+		const ConversionSettings &settings);
+
+/**
+ * 8-bit BGR image (CV_8UC3) to planar image, and back.
+ * each is one pass over rows of the image, split into tasks on pool
+ * (nullptr : calling thread only). toBGRImage() clamps Y, shrinks planes
+ * to outputSize, converts colour and quantizes to 8-bit in the pass.
+ * grayscale image (B = G = R everywhere) gets no chroma planes, and
+ * comes back as 8-bit grayscale image (CV_8UC1).
+ */
+void toPlanarImage(const cv::Mat &bgrImage, PlanarImage &image,
+		ThreadPool *pool);
+void toBGRImage(const PlanarImage &image, cv::Mat &bgrImage,
+		ThreadPool *pool);
+
+/**
+ * read image file (or encoded image in memory) into planar image
+ * (converted on pool, see toPlanarImage()).
+ * errors (unreadable file, exception from OpenCV or out of memory) are
+ * reported and returned as false, so that callers can go on with other
+ * images.
+ */
+bool decodeImage(const std::string &inputFileName, PlanarImage &image,
+		ThreadPool *pool);
+bool decodeImage(const std::vector<unsigned char> &data,
+		PlanarImage &image, ThreadPool *pool);
+
+// write planar image to image file (converted on pool, see toBGRImage())
+bool encodeImage(const PlanarImage &image,
+		const std::string &outputFileName, ThreadPool *pool);
+
+}
+
+#endif /* IMAGE_CONVERSION_HPP_ */
@@ -0,0 +1,192 @@
+/*
+ * inputFiles.cpp
+ *   input image files of batch conversion
+ */
+
+#include "inputFiles.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cctype>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <dirent.h>
+#include <glob.h>
+#endif
+
+namespace w2xc {
+
+static const char *const imageExtensions[] = { "png", "jpg", "jpeg", "bmp",
+		"webp", "tif", "tiff" };
+
+static bool isImageFileName(const std::string &fileName) {
+	std::string::size_type dot = fileName.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+	std::string extension = fileName.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+			[](unsigned char c) {return static_cast<char>(std::tolower(c));});
+	for (auto&& imageExtension : imageExtensions) {
+		if (extension == imageExtension)
+			return true;
+	}
+	return false;
+}
+
+static bool isSeparator(char c) {
+#ifdef _WIN32
+	return c == '/' || c == '\\';
+#else
+	return c == '/';
+#endif
+}
+
+// path with separator at the end (for joining file name)
+static std::string getDirectoryPrefix(const std::string &path) {
+	if (path.empty() || isSeparator(path.back()))
+		return path;
+	return path + "/";
+}
+
+std::string getBaseName(const std::string &path) {
+	std::string::size_type end = path.size();
+	while (end > 0 && isSeparator(path[end - 1])) {
+		end--;
+	}
+	std::string::size_type begin = end;
+	while (begin > 0 && !isSeparator(path[begin - 1])) {
+		begin--;
+	}
+	return path.substr(begin, end - begin);
+}
+
+bool isWildcardPattern(const std::string &path) {
+	return path.find_first_of("*?") != std::string::npos;
+}
+
+#ifdef _WIN32
+
+bool isDirectory(const std::string &path) {
+	DWORD attributes = GetFileAttributesA(path.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES
+			&& (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+}
+
+// FindFirstFile takes both directory (as "dir/*") and pattern
+static bool findFiles(const std::string &pattern, const std::string &prefix,
+		bool imagesOnly, std::vector<std::string> &files) {
+	WIN32_FIND_DATAA findData;
+	HANDLE findHandle = FindFirstFileA(pattern.c_str(), &findData);
+	if (findHandle == INVALID_HANDLE_VALUE) {
+		return GetLastError() == ERROR_FILE_NOT_FOUND;
+	}
+	do {
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+		std::string fileName(findData.cFileName);
+		if (!imagesOnly || isImageFileName(fileName))
+			files.push_back(prefix + fileName);
+	} while (FindNextFileA(findHandle, &findData));
+	FindClose(findHandle);
+	return true;
+}
+
+bool listInputFiles(const std::string &path, std::vector<std::string> &files) {
+	files.clear();
+	bool succeeded;
+	if (isWildcardPattern(path)) {
+		std::string::size_type end = path.find_last_of("/\\");
+		std::string prefix =
+				(end == std::string::npos) ? "" : path.substr(0, end + 1);
+		succeeded = findFiles(path, prefix, false, files);
+	} else {
+		std::string prefix = getDirectoryPrefix(path);
+		succeeded = findFiles(prefix + "*", prefix, true, files);
+	}
+	if (!succeeded) {
+		std::cerr << "Error : couldn't read " << path << std::endl;
+		return false;
+	}
+	std::sort(files.begin(), files.end());
+	return true;
+}
+
+#else
+
+bool isDirectory(const std::string &path) {
+	struct stat status;
+	return stat(path.c_str(), &status) == 0 && S_ISDIR(status.st_mode);
+}
+
+static bool isRegularFile(const std::string &path) {
+	struct stat status;
+	return stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode);
+}
+
+bool listInputFiles(const std::string &path, std::vector<std::string> &files) {
+	files.clear();
+
+	if (isWildcardPattern(path)) {
+		glob_t globResult;
+		int ret = glob(path.c_str(), 0, nullptr, &globResult);
+		if (ret != 0 && ret != GLOB_NOMATCH) {
+			std::cerr << "Error : couldn't read " << path << std::endl;
+			return false;
+		}
+		for (std::size_t index = 0; ret == 0 && index < globResult.gl_pathc;
+				index++) {
+			std::string fileName(globResult.gl_pathv[index]);
+			if (isRegularFile(fileName))
+				files.push_back(fileName);
+		}
+		globfree(&globResult);
+		return true; // glob() sorts its result
+	}
+
+	DIR *directory = opendir(path.c_str());
+	if (directory == nullptr) {
+		std::cerr << "Error : couldn't read " << path << std::endl;
+		return false;
+	}
+	std::string prefix = getDirectoryPrefix(path);
+	while (struct dirent *entry = readdir(directory)) {
+		std::string fileName(entry->d_name);
+		if (isImageFileName(fileName) && isRegularFile(prefix + fileName))
+			files.push_back(prefix + fileName);
+	}
+	closedir(directory);
+
+	std::sort(files.begin(), files.end());
+	return true;
+}
+
+#endif
+
+bool readInputList(const std::string &listFileName,
+		std::vector<std::string> &files) {
+	files.clear();
+
+	std::ifstream listFile(listFileName);
+	if (!listFile.is_open()) {
+		std::cerr << "Error : couldn't open " << listFileName << std::endl;
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(listFile, line)) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (!line.empty())
+			files.push_back(line);
+	}
+
+	return true;
+}
+
+}
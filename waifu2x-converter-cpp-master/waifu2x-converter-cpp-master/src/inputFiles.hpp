@@ -0,0 +1,39 @@
+/*
+ * inputFiles.hpp
+ *   input image files of batch conversion
+ *   (directory, wildcard pattern or list file)
+ */
+
+#ifndef INPUT_FILES_HPP_
+#define INPUT_FILES_HPP_
+
+#include <string>
+#include <vector>
+
+namespace w2xc {
+
+bool isDirectory(const std::string &path);
+// path contains '*' or '?'
+bool isWildcardPattern(const std::string &path);
+
+/**
+ * image files (by extension : png, jpg, jpeg, bmp, webp, tif, tiff,
+ * ignoring case) in a directory, or files matching a wildcard pattern
+ * (wildcards in the last component only), in sorted order.
+ * returns false if the directory cannot be read.
+ */
+bool listInputFiles(const std::string &path, std::vector<std::string> &files);
+
+/**
+ * files in a list file, one per line
+ * (empty lines are skipped, CR of CRLF is removed)
+ */
+bool readInputList(const std::string &listFileName,
+		std::vector<std::string> &files);
+
+// last component of path
+std::string getBaseName(const std::string &path);
+
+}
+
+#endif /* INPUT_FILES_HPP_ */
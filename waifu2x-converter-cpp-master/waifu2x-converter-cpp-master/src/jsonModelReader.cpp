@@ -0,0 +1,365 @@
+/*
+ * jsonModelReader.cpp
+ *   streaming reader of JSON model
+ */
+
+#include "jsonModelReader.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+
+namespace w2xc {
+
+// bytes read from stream at once
+static constexpr std::size_t readerChunkSize = 1 << 16;
+// longest number token (longer ones are malformed for a model)
+static constexpr std::size_t maxNumberLength = 64;
+
+// powers of ten which are exact in double
+static const double exactPowersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6,
+		1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+		1e19, 1e20, 1e21, 1e22 };
+
+/**
+ * number token to correctly rounded double.
+ * if decimal mantissa fits in 53 bits and |exponent| <= 22, one multiply
+ * or divide of exact values rounds correctly (Clinger's fast path);
+ * other numbers go to strtod.
+ */
+static double parseDouble(const char *token) {
+	const char *p = token;
+	bool negative = (*p == '-');
+	if (negative || *p == '+')
+		p++;
+
+	uint64_t mantissa = 0;
+	int nDigits = 0; // significant digits in mantissa
+	int exponent = 0;
+	bool exact = true;
+	for (; *p >= '0' && *p <= '9'; p++) {
+		if (mantissa == 0 && *p == '0')
+			continue;
+		if (nDigits == 19) {
+			exact = false;
+			break;
+		}
+		mantissa = mantissa * 10 + (*p - '0');
+		nDigits++;
+	}
+	if (exact && *p == '.') {
+		for (p++; *p >= '0' && *p <= '9'; p++) {
+			if (mantissa == 0 && *p == '0') {
+				exponent--;
+				continue;
+			}
+			if (nDigits == 19) {
+				exact = false;
+				break;
+			}
+			mantissa = mantissa * 10 + (*p - '0');
+			nDigits++;
+			exponent--;
+		}
+	}
+	if (exact && (*p == 'e' || *p == 'E')) {
+		p++;
+		bool negativeExponent = (*p == '-');
+		if (negativeExponent || *p == '+')
+			p++;
+		int value = 0;
+		for (; *p >= '0' && *p <= '9'; p++) {
+			if (value < 10000)
+				value = value * 10 + (*p - '0');
+		}
+		exponent += negativeExponent ? -value : value;
+	}
+
+	if (exact && mantissa == 0) {
+		return negative ? -0.0 : 0.0;
+	}
+	if (!exact || mantissa > (1ULL << 53) || exponent < -22 || exponent > 22) {
+		return std::strtod(token, nullptr);
+	}
+	double value = static_cast<double>(mantissa);
+	value = exponent < 0 ? value / exactPowersOf10[-exponent] :
+			value * exactPowersOf10[exponent];
+	return negative ? -value : value;
+}
+
+class JSONModelParser {
+
+private:
+	std::istream &stream;
+	std::vector<char> buffer;
+	std::size_t position;
+	std::size_t length;
+	std::size_t consumed; // bytes before buffer (for messages)
+	std::string error;
+
+	bool fill() {
+		consumed += length;
+		stream.read(buffer.data(), buffer.size());
+		length = static_cast<std::size_t>(stream.gcount());
+		position = 0;
+		return length > 0;
+	}
+	// next character (-1 at end of stream)
+	int peek() {
+		if (position == length && !fill())
+			return -1;
+		return static_cast<unsigned char>(buffer[position]);
+	}
+	void skipSpace() {
+		for (int c = peek();
+				c == ' ' || c == '\t' || c == '\n' || c == '\r';
+				c = peek()) {
+			position++;
+		}
+	}
+	bool fail(const std::string &message) {
+		if (error.empty()) {
+			std::ostringstream stringStream;
+			stringStream << message << " at byte " << (consumed + position);
+			error = stringStream.str();
+		}
+		return false;
+	}
+	bool expect(char expected) {
+		skipSpace();
+		if (peek() != expected)
+			return fail(std::string("'") + expected + "' is expected");
+		position++;
+		return true;
+	}
+
+	bool parseNumber(double &value) {
+		skipSpace();
+		char token[maxNumberLength + 1];
+		std::size_t n = 0;
+		for (int c = peek();
+				(c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.'
+						|| c == 'e' || c == 'E'; c = peek()) {
+			if (n == maxNumberLength)
+				return fail("number is too long");
+			token[n++] = static_cast<char>(c);
+			position++;
+		}
+		if (n == 0)
+			return fail("number is expected");
+		token[n] = '\0';
+		value = parseDouble(token);
+		return true;
+	}
+
+	// (escapes are kept as they are, keys of models are plain)
+	bool parseString(std::string &value) {
+		if (!expect('"'))
+			return false;
+		value.clear();
+		for (int c = peek(); c != '"'; c = peek()) {
+			if (c < 0)
+				return fail("string is not closed");
+			position++;
+			value.push_back(static_cast<char>(c));
+			if (c == '\\') {
+				if (peek() < 0)
+					return fail("string is not closed");
+				value.push_back(static_cast<char>(peek()));
+				position++;
+			}
+		}
+		position++;
+		return true;
+	}
+
+	bool skipValue() {
+		skipSpace();
+		int c = peek();
+		if (c == '"') {
+			std::string ignored;
+			return parseString(ignored);
+		}
+		if (c == '[' || c == '{') {
+			char close = (c == '[') ? ']' : '}';
+			position++;
+			skipSpace();
+			if (peek() == close) {
+				position++;
+				return true;
+			}
+			while (true) {
+				if (close == '}') {
+					std::string key;
+					if (!parseString(key) || !expect(':'))
+						return false;
+				}
+				if (!skipValue())
+					return false;
+				skipSpace();
+				if (peek() == close) {
+					position++;
+					return true;
+				}
+				if (!expect(','))
+					return false;
+			}
+		}
+		if (c == 't' || c == 'f' || c == 'n') {
+			// true, false, null
+			while (peek() >= 'a' && peek() <= 'z') {
+				position++;
+			}
+			return true;
+		}
+		double ignored;
+		return parseNumber(ignored);
+	}
+
+	// numbers of nested arrays, flattened in order
+	bool parseFloatArray(std::vector<float> &values) {
+		if (!expect('['))
+			return false;
+		skipSpace();
+		if (peek() == ']') {
+			position++;
+			return true;
+		}
+		while (true) {
+			skipSpace();
+			if (peek() == '[') {
+				if (!parseFloatArray(values))
+					return false;
+			} else {
+				double value;
+				if (!parseNumber(value))
+					return false;
+				values.push_back(static_cast<float>(value));
+			}
+			skipSpace();
+			if (peek() == ']') {
+				position++;
+				return true;
+			}
+			if (!expect(','))
+				return false;
+		}
+	}
+
+	bool parseInteger(int &value) {
+		double number;
+		if (!parseNumber(number))
+			return false;
+		value = static_cast<int>(number);
+		return true;
+	}
+
+	bool parseLayer(JSONModelLayer &layer, int index) {
+		layer.nInputPlanes = layer.nOutputPlanes = layer.kernelSize = 0;
+		layer.weights.clear();
+		layer.biases.clear();
+		int kH = 0;
+
+		if (!expect('{'))
+			return false;
+		skipSpace();
+		if (peek() != '}') {
+			while (true) {
+				std::string key;
+				if (!parseString(key) || !expect(':'))
+					return false;
+				bool parsed;
+				if (key == "nInputPlane") {
+					parsed = parseInteger(layer.nInputPlanes);
+				} else if (key == "nOutputPlane") {
+					parsed = parseInteger(layer.nOutputPlanes);
+				} else if (key == "kW") {
+					parsed = parseInteger(layer.kernelSize);
+				} else if (key == "kH") {
+					parsed = parseInteger(kH);
+				} else if (key == "weight") {
+					parsed = parseFloatArray(layer.weights);
+				} else if (key == "bias") {
+					parsed = parseFloatArray(layer.biases);
+				} else {
+					parsed = skipValue();
+				}
+				if (!parsed)
+					return false;
+				skipSpace();
+				if (peek() == '}')
+					break;
+				if (!expect(','))
+					return false;
+			}
+		}
+		position++;
+
+		std::ostringstream layerName;
+		layerName << "layer " << index;
+		if (layer.nInputPlanes <= 0 || layer.nOutputPlanes <= 0
+				|| layer.kernelSize <= 0) {
+			return fail(layerName.str() + " has no size");
+		}
+		if (layer.kernelSize != kH) {
+			return fail(layerName.str() + " : kernel is not square");
+		}
+		if (layer.weights.size()
+				!= static_cast<std::size_t>(layer.nOutputPlanes)
+						* layer.nInputPlanes * layer.kernelSize
+						* layer.kernelSize
+				|| layer.biases.size()
+						!= static_cast<std::size_t>(layer.nOutputPlanes)) {
+			return fail(layerName.str() + " has wrong number of weights");
+		}
+		return true;
+	}
+
+public:
+	JSONModelParser(std::istream &stream) :
+			stream(stream), buffer(readerChunkSize), position(0), length(0),
+			consumed(0) {
+	}
+
+	bool parseModel(
+			const std::function<bool(const JSONModelLayer &)> &onLayer) {
+		if (!expect('['))
+			return false;
+		skipSpace();
+		if (peek() == ']')
+			return true;
+
+		JSONModelLayer layer;
+		for (int index = 0;; index++) {
+			if (!parseLayer(layer, index))
+				return false;
+			if (!onLayer(layer)) {
+				std::ostringstream message;
+				message << "layer " << index << " is rejected";
+				return fail(message.str());
+			}
+			skipSpace();
+			if (peek() == ']')
+				return true;
+			if (!expect(','))
+				return false;
+		}
+	}
+
+	const std::string &getError() const {
+		return error;
+	}
+
+};
+
+bool readJSONModel(std::istream &stream,
+		const std::function<bool(const JSONModelLayer &)> &onLayer,
+		std::string &errorMessage) {
+	JSONModelParser parser(stream);
+	if (!parser.parseModel(onLayer)) {
+		errorMessage = parser.getError();
+		return false;
+	}
+	return true;
+}
+
+}
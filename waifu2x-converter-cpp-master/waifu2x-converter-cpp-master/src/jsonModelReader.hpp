@@ -0,0 +1,50 @@
+/*
+ * jsonModelReader.hpp
+ *   streaming reader of JSON model (array of layers with "nInputPlane",
+ *   "nOutputPlane", "kW", "kH", "weight" and "bias")
+ *
+ *   The file is read in chunks, and numbers of "weight" and "bias" are
+ *   parsed straight into float buffers of the layer, without building
+ *   a document tree. Other keys are skipped.
+ *   The buffers are not the storage of Model : Model copies them into its
+ *   own weights and packs them for the backends (see Model::Model()), and
+ *   the buffers are reused for the next layer. So one layer is copied
+ *   once more than with parsing into Model, in exchange for keeping the
+ *   reader independent of Model (convertModel.cpp writes the buffers to
+ *   binary model instead).
+ *   Numbers are rounded to double first, then to float, the same as
+ *   picojson (so weights are the same as with the DOM loader).
+ */
+
+#ifndef JSON_MODEL_READER_HPP_
+#define JSON_MODEL_READER_HPP_
+
+#include <istream>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace w2xc {
+
+struct JSONModelLayer {
+	int nInputPlanes;
+	int nOutputPlanes;
+	int kernelSize;
+	// nOutputPlanes x nInputPlanes x kernelSize x kernelSize
+	std::vector<float> weights;
+	std::vector<float> biases;
+};
+
+/**
+ * read layers from stream, and call onLayer for each layer as soon as it
+ * is read (buffers of the layer are reused for the next layer).
+ * returns false with errorMessage for malformed model, or when onLayer
+ * returns false.
+ */
+bool readJSONModel(std::istream &stream,
+		const std::function<bool(const JSONModelLayer &)> &onLayer,
+		std::string &errorMessage);
+
+}
+
+#endif /* JSON_MODEL_READER_HPP_ */
@@ -14,11 +14,190 @@
 #include <fstream>
 #include <string>
 #include <cmath>
+#include <thread>
+#include <map>
 #include "picojson.h"
 #include "tclap/CmdLine.h"
 
 #include "modelHandler.hpp"
 #include "convertRoutine.hpp"
+#include "cpuFeatures.hpp"
+#include "autotune.hpp"
+#include "inputFiles.hpp"
+#include "boundedQueue.hpp"
+#include "imageConversion.hpp"
+#include "daemon.hpp"
+
+// apply filter backend selected by command line to all layers.
+// layers which cannot use it (not 3x3) keep their default backend.
+static void setFilterBackend(std::vector<std::unique_ptr<w2xc::Model> > &models,
+		const std::string &backendName) {
+	if (backendName == "auto")
+		return;
+
+	w2xc::FilterBackend backend = w2xc::FilterBackend::Direct;
+	if (backendName == "gemm") {
+		backend = w2xc::FilterBackend::GEMM;
+	} else if (backendName == "winograd") {
+		backend = w2xc::FilterBackend::Winograd;
+	}
+
+	for (auto&& model : models) {
+		model->setBackend(backend);
+	}
+}
+
+// load binary model (made by convertModel) if it is next to JSON model and
+// up to date, otherwise JSON model. modelFileName is set to the loaded file.
+static void loadModels(std::string &modelFileName,
+		std::vector<std::unique_ptr<w2xc::Model> > &models) {
+	if (!w2xc::modelUtility::generateModel(modelFileName, models))
+		std::exit(-1);
+}
+
+// apply tuned execution plan of the model from cache file, and set
+// blockSize to its block size.
+// with autotune, benchmark the model and save the plan to cache file.
+// (models without plan keep default settings, and blockSize is empty)
+static void setTunedPlan(std::vector<std::unique_ptr<w2xc::Model> > &models,
+		cv::Size &blockSize, const std::string &modelFileName,
+		const std::string &cacheFileName, bool autotune) {
+	blockSize = cv::Size();
+	std::string key = w2xc::getTuningKey(modelFileName,
+			w2xc::modelUtility::getInstance().getNumberOfJobs());
+	if (key.empty())
+		return;
+
+	w2xc::ExecutionPlan plan;
+	if (autotune) {
+		std::cout << "tuning " << modelFileName << "..." << std::endl;
+		if (!w2xc::autotuneModels(models,
+				w2xc::modelUtility::getInstance().getExecutionContext(),
+				plan)) {
+			std::cerr << "Error : autotune of " << modelFileName << " failed"
+					<< std::endl;
+			std::exit(-1);
+		}
+		if (!w2xc::saveExecutionPlan(cacheFileName, key, plan))
+			std::exit(-1);
+		blockSize = plan.blockSize;
+	} else if (w2xc::loadExecutionPlan(cacheFileName, key, plan)) {
+		if (!w2xc::applyExecutionPlan(plan, models)) {
+			std::cerr << "Error : tuned plan in " << cacheFileName
+					<< " doesn't fit " << modelFileName << std::endl;
+			std::exit(-1);
+		}
+		blockSize = plan.blockSize;
+	}
+}
+
+// switch 3x3 layers to INT8 mode with calibration file of the model.
+// CPUs without AVX2 keep float path (scalar INT8 kernel is slower than it).
+static void setInt8Mode(std::vector<std::unique_ptr<w2xc::Model> > &models,
+		const std::string &modelFileName) {
+	if (w2xc::getCpuFeatureLevel() < w2xc::CpuFeatureLevel::AVX2) {
+		std::cout << "INT8 kernel requires AVX2, float path is used."
+				<< std::endl;
+		return;
+	}
+
+	std::string calibrationFileName =
+			w2xc::modelUtility::getInt8CalibrationFileName(modelFileName);
+	if (!w2xc::modelUtility::loadInt8Calibration(calibrationFileName,
+			models)) {
+		std::cerr << "Error : INT8 mode needs calibration file "
+				<< calibrationFileName << " (made by calibrateInt8)"
+				<< std::endl;
+		std::exit(-1);
+	}
+}
+
+// load model, and apply tuned plan, filter backend and INT8 mode to it
+// (blockSize is set to tuned block size of the model)
+static void prepareModels(std::string modelFileName,
+		std::vector<std::unique_ptr<w2xc::Model> > &models,
+		cv::Size &blockSize, const std::string &tuningCacheFileName,
+		bool autotune, const std::string &backendName, bool int8) {
+	loadModels(modelFileName, models);
+	setTunedPlan(models, blockSize, modelFileName, tuningCacheFileName,
+			autotune);
+	setFilterBackend(models, backendName);
+	if (int8)
+		setInt8Mode(models, modelFileName);
+}
+
+// image passed between stages of batch pipeline
+struct PipelineItem {
+	std::string inputFileName;
+	std::string outputFileName;
+	w2xc::PlanarImage image; // empty if a previous stage failed
+};
+
+/**
+ * convert files by pipeline of 3 stages :
+ * decoder thread (imread) -> calling thread (models) -> encoder thread
+ * (imwrite), so that decoding of next image and encoding of last image
+ * overlap with convolutions. queueDepth images wait between stages at
+ * most, which bounds memory.
+ * returns number of files which failed (they don't stop others).
+ */
+static int convertFiles(std::vector<PipelineItem> &items,
+		const w2xc::ConversionSettings &settings,
+		w2xc::ConversionModels &models, int queueDepth) {
+
+	w2xc::ExecutionContext context =
+			w2xc::modelUtility::getInstance().getExecutionContext();
+	w2xc::BoundedQueue<PipelineItem> decodedQueue(queueDepth);
+	w2xc::BoundedQueue<PipelineItem> convertedQueue(queueDepth);
+
+	std::thread decoder([&] {
+		for (auto&& item : items) {
+			w2xc::decodeImage(item.inputFileName, item.image,
+					context.threadPool);
+			decodedQueue.push(std::move(item));
+		}
+		decodedQueue.close();
+	});
+
+	int nFailed = 0;
+	std::thread encoder([&] {
+		PipelineItem item;
+		while (convertedQueue.pop(item)) {
+			if (item.image.empty() || !w2xc::encodeImage(item.image,
+					item.outputFileName, context.threadPool)) {
+				nFailed++;
+			}
+			item.image.release();
+		}
+	});
+
+	PipelineItem item;
+	while (decodedQueue.pop(item)) {
+		if (!item.image.empty()) {
+			std::cout << item.inputFileName << " -> " << item.outputFileName
+					<< std::endl;
+			bool converted;
+			try {
+				converted = w2xc::convertImage(item.image, settings,
+						models, context);
+			} catch (std::exception &e) {
+				std::cerr << "Error : " << e.what() << std::endl;
+				converted = false;
+			}
+			if (!converted) {
+				std::cerr << "Error : conversion of " << item.inputFileName
+						<< " failed" << std::endl;
+				item.image.release();
+			}
+		}
+		convertedQueue.push(std::move(item));
+	}
+	convertedQueue.close();
+
+	decoder.join();
+	encoder.join();
+	return nFailed;
+}
 
 int main(int argc, char** argv) {
 
@@ -26,11 +205,29 @@ int main(int argc, char** argv) {
 	TCLAP::CmdLine cmd("waifu2x reimplementation using OpenCV", ' ', "1.0.0");
 
 	TCLAP::ValueArg<std::string> cmdInputFile("i", "input_file",
-			"path to input image file (you should input full path)", true, "",
-			"string", cmd);
+			"path to input image file (you should input full path), "
+			"or directory or wildcard pattern (quoted) of input files",
+			true, "", "string");
+
+	TCLAP::ValueArg<std::string> cmdInputList("", "input_list",
+			"path to text file listing input image files (one per line)",
+			true, "", "string");
+
+	TCLAP::ValueArg<std::string> cmdDaemonSocket("", "daemon",
+			"run as daemon which converts images requested over UNIX "
+			"domain socket of this path (see README), keeping models "
+			"loaded", true, "", "string");
+
+	std::vector<TCLAP::Arg *> cmdInputXor;
+	cmdInputXor.push_back(&cmdInputFile);
+	cmdInputXor.push_back(&cmdInputList);
+	cmdInputXor.push_back(&cmdDaemonSocket);
+	cmd.xorAdd(cmdInputXor);
 
 	TCLAP::ValueArg<std::string> cmdOutputFile("o", "output_file",
-			"path to output image file (you should input full path)", false,
+			"path to output image file (you should input full path), "
+			"or output directory for multiple input files or daemon",
+			false,
 			"(auto)", "string", cmd);
 
 	std::vector<std::string> cmdModeConstraintV;
@@ -51,6 +248,10 @@ int main(int argc, char** argv) {
 	TCLAP::ValueArg<double> cmdScaleRatio("", "scale_ratio",
 			"custom scale ratio", false, 2.0, "double", cmd);
 
+	TCLAP::ValueArg<int> cmdQueueDepth("", "queue_depth",
+			"number of images waiting between decoding, conversion and "
+			"encoding of multiple input files", false, 2, "integer", cmd);
+
 	TCLAP::ValueArg<std::string> cmdModelPath("", "model_dir",
 			"path to custom model directory (don't append last / )", false,
 			"models", "string", cmd);
@@ -59,6 +260,61 @@ int main(int argc, char** argv) {
 			"number of threads launching at the same time", false, 4, "integer",
 			cmd);
 
+	TCLAP::SwitchArg cmdTileFusion("", "tile_fusion",
+			"process small tiles through all layers at once (depth-first)",
+			cmd, false);
+
+	TCLAP::ValueArg<int> cmdTileFusionSize("", "tile_fusion_size",
+			"edge length of tile in depth-first processing (0 : auto)", false,
+			0, "integer", cmd);
+
+	TCLAP::SwitchArg cmdStreaming("", "streaming",
+			"process image row by row through all layers (low memory)", cmd,
+			false);
+
+	TCLAP::SwitchArg cmdHalfActivations("", "fp16_activations",
+			"store planes between layers in half precision (halves memory, "
+			"not used with --tile_fusion and --streaming)", cmd, false);
+
+	TCLAP::SwitchArg cmdInt8("", "int8",
+			"run 3x3 layers in 8-bit integer (needs calibration file "
+			"<model>.int8.json next to model file)", cmd, false);
+
+	std::vector<std::string> cmdBackendConstraintV;
+	cmdBackendConstraintV.push_back("auto");
+	cmdBackendConstraintV.push_back("direct");
+	cmdBackendConstraintV.push_back("gemm");
+	cmdBackendConstraintV.push_back("winograd");
+	TCLAP::ValuesConstraint<std::string> cmdBackendConstraint(
+			cmdBackendConstraintV);
+	TCLAP::ValueArg<std::string> cmdFilterBackend("", "filter_backend",
+			"convolution algorithm of 3x3 layers", false, "auto",
+			&cmdBackendConstraint, cmd);
+
+	TCLAP::SwitchArg cmdAutotune("", "autotune",
+			"benchmark backend, task split and block size for this machine, "
+			"and save them to tuning cache file", cmd, false);
+
+	TCLAP::ValueArg<std::string> cmdTuningCache("", "tuning_cache",
+			"path to tuning cache file (used when it has a plan for the "
+			"model on this machine)", false, "waifu2x_tuning.json", "string",
+			cmd);
+
+	std::vector<std::string> cmdCpuFeaturesConstraintV;
+	cmdCpuFeaturesConstraintV.push_back("auto");
+	cmdCpuFeaturesConstraintV.push_back("scalar");
+	cmdCpuFeaturesConstraintV.push_back("universal");
+	cmdCpuFeaturesConstraintV.push_back("sse4.1");
+	cmdCpuFeaturesConstraintV.push_back("avx2");
+	cmdCpuFeaturesConstraintV.push_back("avx512");
+	cmdCpuFeaturesConstraintV.push_back("avx512vnni");
+	TCLAP::ValuesConstraint<std::string> cmdCpuFeaturesConstraint(
+			cmdCpuFeaturesConstraintV);
+	TCLAP::ValueArg<std::string> cmdCpuFeatures("", "cpu_features",
+			"instruction set of direct 3x3 kernel (lower than detected one "
+			"can be forced for comparison)", false, "auto",
+			&cmdCpuFeaturesConstraint, cmd);
+
 	// definition of command line argument : end
 
 	// parse command line arguments
@@ -69,125 +325,147 @@ int main(int argc, char** argv) {
 		std::cerr << "Error : cmd.parse() threw exception" << std::endl;
 		std::exit(-1);
 	}
+	if (cmdQueueDepth.getValue() < 1) {
+		std::cerr << "Error : --queue_depth must be 1 or more" << std::endl;
+		std::exit(-1);
+	}
 
-	// load image file
-	cv::Mat image = cv::imread(cmdInputFile.getValue(), cv::IMREAD_COLOR);
-	image.convertTo(image, CV_32F, 1.0 / 255.0);
-	cv::cvtColor(image, image, cv::COLOR_RGB2YUV);
+	// select instruction set of kernels
+	if (cmdCpuFeatures.getValue() != "auto") {
+		w2xc::CpuFeatureLevel level;
+		w2xc::parseCpuFeatureLevel(cmdCpuFeatures.getValue(), level);
+		if (!w2xc::setCpuFeatureLevel(level)) {
+			std::cerr << "Error : this CPU doesn't support "
+					<< cmdCpuFeatures.getValue() << " (supported up to "
+					<< w2xc::getCpuFeatureLevelName(
+							w2xc::detectCpuFeatureLevel()) << ")"
+					<< std::endl;
+			std::exit(-1);
+		}
+	}
 
 	// set number of jobs for processing models
 	w2xc::modelUtility::getInstance().setNumberOfJobs(cmdNumberOfJobs.getValue());
+	w2xc::modelUtility::getInstance().setTileFusion(cmdTileFusion.getValue());
+	w2xc::modelUtility::getInstance().setTileFusionSize(
+			cmdTileFusionSize.getValue());
+	w2xc::modelUtility::getInstance().setStreaming(cmdStreaming.getValue());
+	w2xc::modelUtility::getInstance().setHalfActivations(
+			cmdHalfActivations.getValue());
+	// start worker threads once for all images
+	w2xc::modelUtility::getInstance().getThreadPool();
+
+	w2xc::ConversionSettings settings;
+	settings.mode = cmdMode.getValue();
+	settings.noiseLevel = cmdNRLevel.getValue();
+	settings.scaleRatio = cmdScaleRatio.getValue();
+
+	// load models once for all images
+	// (daemon keeps models of all modes)
+	bool daemonMode = cmdDaemonSocket.isSet();
+	bool noiseMode = (settings.mode == "noise"
+			|| settings.mode == "noise_scale");
+	bool scaleMode = (settings.mode == "scale"
+			|| settings.mode == "noise_scale");
+	w2xc::ConversionModels models;
+	for (int level = 1; level <= 2; level++) {
+		if (daemonMode || (noiseMode && settings.noiseLevel == level)) {
+			prepareModels(cmdModelPath.getValue() + "/noise"
+					+ std::to_string(level) + "_model.json",
+					models.noise[level - 1], models.noiseBlockSize[level - 1],
+					cmdTuningCache.getValue(),
+					cmdAutotune.getValue(), cmdFilterBackend.getValue(),
+					cmdInt8.getValue());
+		}
+	}
+	if (daemonMode || scaleMode) {
+		prepareModels(cmdModelPath.getValue() + "/scale2.0x_model.json",
+				models.scale, models.scaleBlockSize, cmdTuningCache.getValue(),
+				cmdAutotune.getValue(), cmdFilterBackend.getValue(),
+				cmdInt8.getValue());
+	}
 
-	// ===== Noise Reduction Phase =====
-	if (cmdMode.getValue() == "noise" || cmdMode.getValue() == "noise_scale") {
-		std::string modelFileName(cmdModelPath.getValue());
-		modelFileName = modelFileName + "/noise"
-				+ std::to_string(cmdNRLevel.getValue()) + "_model.json";
-		std::vector<std::unique_ptr<w2xc::Model> > models;
+	if (daemonMode) {
+		std::string outputDirectory = cmdOutputFile.getValue();
+		if (outputDirectory == "(auto)")
+			outputDirectory = w2xc::getDefaultDaemonOutputDirectory();
+		// (progress of concurrent requests is not printed)
+		w2xc::ExecutionContext context =
+				w2xc::modelUtility::getInstance().getExecutionContext();
+		context.verbose = false;
+		return w2xc::runDaemon(cmdDaemonSocket.getValue(), outputDirectory,
+				models, context) ? 0 : 1;
+	}
 
-		if (!w2xc::modelUtility::generateModelFromJSON(modelFileName, models))
+	// list input files
+	std::vector<std::string> inputFileNames;
+	bool batchMode = cmdInputList.isSet()
+			|| w2xc::isDirectory(cmdInputFile.getValue())
+			|| w2xc::isWildcardPattern(cmdInputFile.getValue());
+	if (cmdInputList.isSet()) {
+		if (!w2xc::readInputList(cmdInputList.getValue(), inputFileNames))
 			std::exit(-1);
+	} else if (batchMode) {
+		if (!w2xc::listInputFiles(cmdInputFile.getValue(), inputFileNames))
+			std::exit(-1);
+	} else {
+		inputFileNames.push_back(cmdInputFile.getValue());
+	}
+	if (inputFileNames.empty()) {
+		std::cerr << "Error : no input file" << std::endl;
+		std::exit(-1);
+	}
+	if (batchMode && cmdOutputFile.getValue() != "(auto)"
+			&& !w2xc::isDirectory(cmdOutputFile.getValue())) {
+		std::cerr << "Error : output directory "
+				<< cmdOutputFile.getValue() << " doesn't exist" << std::endl;
+		std::exit(-1);
+	}
 
-		std::vector<cv::Mat> imageSplit;
-		cv::Mat imageY;
-		cv::split(image, imageSplit);
-		imageSplit[0].copyTo(imageY);
-
-		w2xc::convertWithModels(imageY, imageSplit[0], models);
-
-		cv::merge(imageSplit, image);
-		
-	} // noise reduction phase : end
-
-	// ===== scaling phase =====
-
-	if (cmdMode.getValue() == "scale" || cmdMode.getValue() == "noise_scale") {
-
-		// calculate iteration times of 2x scaling and shrink ratio which will use at last
-		int iterTimesTwiceScaling = static_cast<int>(std::ceil(
-				std::log2(cmdScaleRatio.getValue())));
-		double shrinkRatio = 0.0;
-		if (static_cast<int>(cmdScaleRatio.getValue())
-				!= std::pow(2, iterTimesTwiceScaling)) {
-			shrinkRatio = cmdScaleRatio.getValue()
-					/ std::pow(2.0, static_cast<double>(iterTimesTwiceScaling));
+	// convert files (failure of a file doesn't stop others)
+	std::vector<PipelineItem> items(inputFileNames.size());
+	for (std::size_t index = 0; index < items.size(); index++) {
+		PipelineItem &item = items[index];
+		item.inputFileName = inputFileNames[index];
+		item.outputFileName = cmdOutputFile.getValue();
+		if (item.outputFileName == "(auto)") {
+			item.outputFileName = w2xc::getAutoOutputFileName(item.inputFileName,
+					settings);
+		} else if (batchMode) {
+			std::string directory = item.outputFileName;
+			if (directory.back() != '/' && directory.back() != '\\')
+				directory += "/";
+			item.outputFileName = directory
+					+ w2xc::getBaseName(
+							w2xc::getAutoOutputFileName(item.inputFileName,
+									settings));
 		}
+	}
 
-		std::string modelFileName(cmdModelPath.getValue());
-		modelFileName = modelFileName + "/scale2.0x_model.json";
-		std::vector<std::unique_ptr<w2xc::Model> > models;
-
-		if (!w2xc::modelUtility::generateModelFromJSON(modelFileName, models))
+	// output file names of different inputs can be the same (same base
+	// name in output directory, or only extension differs)
+	std::map<std::string, std::string> inputFileNameOfOutput;
+	for (auto&& item : items) {
+		auto inserted = inputFileNameOfOutput.insert(
+				std::make_pair(item.outputFileName, item.inputFileName));
+		if (!inserted.second) {
+			std::cerr << "Error : " << inserted.first->second << " and "
+					<< item.inputFileName << " have the same output file "
+					<< item.outputFileName << std::endl;
 			std::exit(-1);
-
-		std::cout << "start scaling" << std::endl;
-
-		// 2x scaling
-		for (int nIteration = 0; nIteration < iterTimesTwiceScaling;
-				nIteration++) {
-
-			std::cout << "#" << std::to_string(nIteration + 1)
-					<< " 2x scaling..." << std::endl;
-
-			cv::Size imageSize = image.size();
-			imageSize.width *= 2;
-			imageSize.height *= 2;
-			cv::Mat image2xNearest;
-			cv::resize(image, image2xNearest, imageSize, 0, 0, cv::INTER_NEAREST);
-			std::vector<cv::Mat> imageSplit;
-			cv::Mat imageY;
-			cv::split(image2xNearest, imageSplit);
-			imageSplit[0].copyTo(imageY);
-
-			// generate bicubic scaled image and split
-			imageSplit.clear();
-			cv::Mat image2xBicubic;
-			cv::resize(image,image2xBicubic,imageSize,0,0,cv::INTER_CUBIC);
-			cv::split(image2xBicubic, imageSplit);
-
-			if(!w2xc::convertWithModels(imageY, imageSplit[0], models)){
-				std::cerr << "w2xc::convertWithModels : something error has occured.\n"
-						"stop." << std::endl;
-				std::exit(1);
-			};
-
-			cv::merge(imageSplit, image);
-
-		} // 2x scaling : end
-
-		if (shrinkRatio != 0.0) {
-			cv::Size lastImageSize = image.size();
-			lastImageSize.width =
-					static_cast<int>(static_cast<double>(lastImageSize.width
-							* shrinkRatio));
-			lastImageSize.height =
-					static_cast<int>(static_cast<double>(lastImageSize.height
-							* shrinkRatio));
-			cv::resize(image, image, lastImageSize, 0, 0, cv::INTER_LINEAR);
 		}
-
 	}
 
-	cv::cvtColor(image, image, cv::COLOR_YUV2RGB);
-	image.convertTo(image, CV_8U, 255.0);
-	std::string outputFileName = cmdOutputFile.getValue();
-	if (outputFileName == "(auto)") {
-		outputFileName = cmdInputFile.getValue();
-		int tailDot = outputFileName.find_last_of('.');
-		outputFileName.erase(tailDot, outputFileName.length());
-		outputFileName = outputFileName + "(" + cmdMode.getValue() + ")";
-		std::string &mode = cmdMode.getValue();
-		if(mode.find("noise") != mode.npos){
-			outputFileName = outputFileName + "(Level" + std::to_string(cmdNRLevel.getValue())
-			+ ")";
-		}
-		if(mode.find("scale") != mode.npos){
-			outputFileName = outputFileName + "(x" + std::to_string(cmdScaleRatio.getValue())
-			+ ")";
-		}
-		outputFileName += ".png";
+	int nFailed = convertFiles(items, settings, models,
+			cmdQueueDepth.getValue());
+
+	if (batchMode) {
+		std::cout << (inputFileNames.size() - nFailed) << " of "
+				<< inputFileNames.size() << " files converted" << std::endl;
+	}
+	if (nFailed > 0) {
+		return 1;
 	}
-	cv::imwrite(outputFileName, image);
 
 	std::cout << "process successfully done!" << std::endl;
 
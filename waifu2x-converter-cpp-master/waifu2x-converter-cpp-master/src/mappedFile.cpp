@@ -0,0 +1,118 @@
+/*
+ * mappedFile.cpp
+ *   read-only memory mapping of a whole file
+ */
+
+#include "mappedFile.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace w2xc {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile() :
+		address(nullptr), length(0), fileHandle(INVALID_HANDLE_VALUE),
+		mappingHandle(nullptr) {
+}
+
+bool MappedFile::open(const std::string &fileName) {
+	close();
+
+	fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ,
+			nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		return false;
+	}
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0,
+			0, nullptr);
+	if (mappingHandle == nullptr) {
+		close();
+		return false;
+	}
+	address = static_cast<const unsigned char *>(MapViewOfFile(mappingHandle,
+			FILE_MAP_READ, 0, 0, 0));
+	if (address == nullptr) {
+		close();
+		return false;
+	}
+	length = static_cast<std::size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::close() {
+	if (address != nullptr) {
+		UnmapViewOfFile(address);
+	}
+	if (mappingHandle != nullptr) {
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(fileHandle);
+	}
+	address = nullptr;
+	length = 0;
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+}
+
+#else
+
+MappedFile::MappedFile() :
+		address(nullptr), length(0) {
+}
+
+bool MappedFile::open(const std::string &fileName) {
+	close();
+
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat status;
+	if (fstat(fd, &status) != 0 || status.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+	void *mapped = mmap(nullptr, static_cast<std::size_t>(status.st_size),
+			PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping stays valid after the file is closed
+	::close(fd);
+	if (mapped == MAP_FAILED) {
+		return false;
+	}
+	address = static_cast<const unsigned char *>(mapped);
+	length = static_cast<std::size_t>(status.st_size);
+	return true;
+}
+
+void MappedFile::close() {
+	if (address != nullptr) {
+		munmap(const_cast<unsigned char *>(address), length);
+	}
+	address = nullptr;
+	length = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+}
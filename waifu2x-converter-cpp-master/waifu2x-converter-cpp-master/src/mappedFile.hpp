@@ -0,0 +1,48 @@
+/*
+ * mappedFile.hpp
+ *   read-only memory mapping of a whole file (mmap, or file mapping object
+ *   on Windows)
+ */
+
+#ifndef MAPPED_FILE_HPP_
+#define MAPPED_FILE_HPP_
+
+#include <string>
+#include <cstddef>
+
+namespace w2xc {
+
+class MappedFile {
+
+private:
+	const unsigned char *address;
+	std::size_t length;
+#ifdef _WIN32
+	void *fileHandle;
+	void *mappingHandle;
+#endif
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+public:
+	MappedFile();
+	~MappedFile();
+
+	// returns false if the file cannot be mapped (or is empty)
+	bool open(const std::string &fileName);
+	void close();
+
+	// address is page aligned
+	const unsigned char *data() const {
+		return address;
+	}
+	std::size_t size() const {
+		return length;
+	}
+
+};
+
+}
+
+#endif /* MAPPED_FILE_HPP_ */
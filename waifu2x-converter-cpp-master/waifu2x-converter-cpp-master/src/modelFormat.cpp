@@ -0,0 +1,196 @@
+/*
+ * modelFormat.cpp
+ *   binary model format (made from JSON model by convertModel)
+ */
+
+#include "modelFormat.hpp"
+#include "errorReport.hpp"
+#include <fstream>
+#include <cstring>
+
+namespace w2xc {
+
+static const char binaryModelMagic[8] = { 'W', '2', 'X', 'C', 'M', 'D', 'L',
+		'\0' };
+static constexpr std::size_t binaryModelAlignment = 64;
+
+static std::size_t alignOffset(std::size_t offset) {
+	return (offset + binaryModelAlignment - 1) & ~(binaryModelAlignment - 1);
+}
+
+static constexpr uint64_t fnvOffsetBasis = 0xcbf29ce484222325ULL;
+static constexpr uint64_t fnvPrime = 0x100000001b3ULL;
+
+static uint64_t hashWord(uint64_t hash, uint64_t word) {
+	return (hash ^ word) * fnvPrime;
+}
+
+uint64_t getModelChecksum(const unsigned char *data, std::size_t size) {
+	uint64_t hash = fnvOffsetBasis;
+	for (std::size_t i = 0; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, data + i, sizeof(word));
+		hash = hashWord(hash, word);
+	}
+	return hash;
+}
+
+bool getFileHash(const std::string &fileName, uint64_t &hash) {
+	// JSON model is hashed at every loading, so it is mapped and hashed
+	// in words rather than in bytes
+	MappedFile file;
+	if (!file.open(fileName)) {
+		return false;
+	}
+
+	std::size_t wordsSize = file.size() & ~static_cast<std::size_t>(7);
+	hash = getModelChecksum(file.data(), wordsSize);
+	// last bytes (zero padded) and size, so that trailing zeros count
+	uint64_t lastWord = 0;
+	std::memcpy(&lastWord, file.data() + wordsSize, file.size() - wordsSize);
+	hash = hashWord(hash, lastWord);
+	hash = hashWord(hash, static_cast<uint64_t>(file.size()));
+	return true;
+}
+
+bool writeBinaryModel(const std::string &fileName,
+		const std::vector<BinaryLayer> &layers, uint64_t sourceHash) {
+
+	// layout of the file
+	std::vector<BinaryLayerEntry> entries(layers.size());
+	std::size_t offset = alignOffset(
+			sizeof(BinaryModelHeader)
+					+ layers.size() * sizeof(BinaryLayerEntry));
+	for (std::size_t index = 0; index < layers.size(); index++) {
+		const BinaryLayer &layer = layers[index];
+		BinaryLayerEntry &entry = entries[index];
+		std::memset(&entry, 0, sizeof(entry));
+		entry.nInputPlanes = static_cast<uint32_t>(layer.nInputPlanes);
+		entry.nOutputPlanes = static_cast<uint32_t>(layer.nOutputPlanes);
+		entry.kernelSize = static_cast<uint32_t>(layer.kernelSize);
+		entry.weightsOffset = offset;
+		offset = alignOffset(offset
+				+ sizeof(float) * layer.nOutputPlanes * layer.nInputPlanes
+						* layer.kernelSize * layer.kernelSize);
+		entry.biasesOffset = offset;
+		offset = alignOffset(offset + sizeof(float) * layer.nOutputPlanes);
+	}
+
+	// whole file in memory (models are tens of megabytes at most)
+	std::vector<unsigned char> image(offset, 0);
+	std::memcpy(image.data() + sizeof(BinaryModelHeader), entries.data(),
+			entries.size() * sizeof(BinaryLayerEntry));
+	for (std::size_t index = 0; index < layers.size(); index++) {
+		const BinaryLayer &layer = layers[index];
+		std::memcpy(image.data() + entries[index].weightsOffset,
+				layer.weights,
+				sizeof(float) * layer.nOutputPlanes * layer.nInputPlanes
+						* layer.kernelSize * layer.kernelSize);
+		std::memcpy(image.data() + entries[index].biasesOffset, layer.biases,
+				sizeof(float) * layer.nOutputPlanes);
+	}
+
+	BinaryModelHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, binaryModelMagic, sizeof(header.magic));
+	header.version = binaryModelVersion;
+	header.nLayers = static_cast<uint32_t>(layers.size());
+	header.fileSize = image.size();
+	header.sourceHash = sourceHash;
+	header.checksum = getModelChecksum(image.data() + sizeof(header),
+			image.size() - sizeof(header));
+	std::memcpy(image.data(), &header, sizeof(header));
+
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file.is_open()) {
+		reportError("couldn't open " + fileName);
+		return false;
+	}
+	file.write(reinterpret_cast<const char *>(image.data()), image.size());
+	if (!file) {
+		reportError("couldn't write " + fileName);
+		return false;
+	}
+
+	return true;
+}
+
+bool readBinaryModel(const MappedFile &file,
+		std::vector<BinaryLayer> &layers, uint64_t &sourceHash) {
+
+	const unsigned char *data = file.data();
+	std::size_t size = file.size();
+
+	BinaryModelHeader header;
+	if (size < sizeof(header)) {
+		reportError("binary model is too short");
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, binaryModelMagic, sizeof(header.magic))
+			!= 0) {
+		reportError("not a binary model");
+		return false;
+	}
+	if (header.version != binaryModelVersion) {
+		reportError("binary model version " + std::to_string(header.version)
+				+ " is not supported (supported : "
+				+ std::to_string(binaryModelVersion) + ")");
+		return false;
+	}
+	if (header.fileSize != size || size % binaryModelAlignment != 0
+			|| (size - sizeof(header)) / sizeof(BinaryLayerEntry)
+					< header.nLayers) {
+		reportError("binary model is truncated");
+		return false;
+	}
+	if (getModelChecksum(data + sizeof(header), size - sizeof(header))
+			!= header.checksum) {
+		reportError("checksum of binary model mismatch");
+		return false;
+	}
+
+	sourceHash = header.sourceHash;
+	layers.clear();
+	for (uint32_t index = 0; index < header.nLayers; index++) {
+		BinaryLayerEntry entry;
+		std::memcpy(&entry,
+				data + sizeof(header) + index * sizeof(BinaryLayerEntry),
+				sizeof(entry));
+
+		uint64_t nWeights = static_cast<uint64_t>(entry.nOutputPlanes)
+				* entry.nInputPlanes * entry.kernelSize * entry.kernelSize;
+		if (entry.weightsOffset % binaryModelAlignment != 0
+				|| entry.biasesOffset % binaryModelAlignment != 0
+				|| entry.weightsOffset > size
+				|| (size - entry.weightsOffset) / sizeof(float) < nWeights
+				|| entry.biasesOffset > size
+				|| (size - entry.biasesOffset) / sizeof(float)
+						< entry.nOutputPlanes) {
+			reportError("layer " + std::to_string(index)
+					+ " of binary model is out of file");
+			return false;
+		}
+		if (entry.nInputPlanes == 0 || entry.nOutputPlanes == 0
+				|| entry.kernelSize == 0) {
+			reportError("layer " + std::to_string(index)
+					+ " of binary model has no planes or no kernel");
+			return false;
+		}
+
+		BinaryLayer layer;
+		layer.nInputPlanes = static_cast<int>(entry.nInputPlanes);
+		layer.nOutputPlanes = static_cast<int>(entry.nOutputPlanes);
+		layer.kernelSize = static_cast<int>(entry.kernelSize);
+		// aligned : mapping is page aligned, offsets are aligned
+		layer.weights = reinterpret_cast<const float *>(data
+				+ entry.weightsOffset);
+		layer.biases = reinterpret_cast<const float *>(data
+				+ entry.biasesOffset);
+		layers.push_back(layer);
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,91 @@
+/*
+ * modelFormat.hpp
+ *   binary model format (made from JSON model by convertModel)
+ *
+ *   The file is read through memory mapping without parsing, and Model
+ *   copies weights of each layer from the mapping into its own buffers
+ *   (the mapping is closed after loading). So the format saves parsing of
+ *   JSON, not memory of weights. All values are little-endian, offsets
+ *   are from the beginning of the file.
+ *   sourceHash is the hash of JSON model which the file is made from, so
+ *   that the file is not used after JSON model is changed.
+ *
+ *   header (64 bytes)
+ *     char[8]  magic         "W2XCMDL\0"
+ *     uint32   version       binaryModelVersion
+ *     uint32   nLayers
+ *     uint64   fileSize
+ *     uint64   checksum      of bytes [64, fileSize) (see getModelChecksum())
+ *     uint64   sourceHash    of JSON model file (see getFileHash())
+ *     (zero up to 64 bytes)
+ *   layer table (nLayers x 32 bytes) at 64
+ *     uint32   nInputPlanes, nOutputPlanes, kernelSize, (zero)
+ *     uint64   weightsOffset float[nOutputPlanes][nInputPlanes][kH][kW]
+ *     uint64   biasesOffset  float[nOutputPlanes]
+ *   weights and biases of each layer, each aligned to 64 bytes
+ *   (the file is padded to a multiple of 64 bytes)
+ */
+
+#ifndef MODEL_FORMAT_HPP_
+#define MODEL_FORMAT_HPP_
+
+#include "mappedFile.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace w2xc {
+
+constexpr uint32_t binaryModelVersion = 3;
+
+struct BinaryModelHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t nLayers;
+	uint64_t fileSize;
+	uint64_t checksum;
+	uint64_t sourceHash;
+	uint8_t reserved[24];
+};
+
+struct BinaryLayerEntry {
+	uint32_t nInputPlanes;
+	uint32_t nOutputPlanes;
+	uint32_t kernelSize;
+	uint32_t reserved;
+	uint64_t weightsOffset;
+	uint64_t biasesOffset;
+};
+
+static_assert(sizeof(BinaryModelHeader) == 64, "header must be 64 bytes");
+static_assert(sizeof(BinaryLayerEntry) == 32, "entry must be 32 bytes");
+
+// weights and biases of a layer (in the mapped file, or to be written)
+struct BinaryLayer {
+	int nInputPlanes;
+	int nOutputPlanes;
+	int kernelSize;
+	const float *weights;
+	const float *biases;
+};
+
+// FNV-1a (64 bit) over 8-byte little-endian words (size is multiple of 8)
+uint64_t getModelChecksum(const unsigned char *data, std::size_t size);
+// FNV-1a (64 bit) over 8-byte words of a file, zero padded, and its size
+// (false if it cannot be read, or is empty)
+bool getFileHash(const std::string &fileName, uint64_t &hash);
+
+bool writeBinaryModel(const std::string &fileName,
+		const std::vector<BinaryLayer> &layers, uint64_t sourceHash);
+
+/**
+ * check header, checksum and layer table of mapped binary model, and set
+ * pointers of layers into it (valid while file is mapped), and sourceHash.
+ * returns false with message for broken or unsupported file.
+ */
+bool readBinaryModel(const MappedFile &file, std::vector<BinaryLayer> &layers,
+		uint64_t &sourceHash);
+
+}
+
+#endif /* MODEL_FORMAT_HPP_ */
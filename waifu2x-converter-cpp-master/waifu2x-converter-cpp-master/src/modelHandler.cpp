@@ -9,12 +9,40 @@
  */
 
 #include "modelHandler.hpp"
+#include "filterKernels.hpp"
+#include "gemmConv.hpp"
+#include "winogradConv.hpp"
+#include "modelFormat.hpp"
+#include "jsonModelReader.hpp"
+#include "errorReport.hpp"
 // #include <iostream> in modelHandler.hpp
 #include <fstream>
-#include <thread>
+#include <algorithm>
 
 namespace w2xc {
 
+Model::Model(int nInputPlanes, int nOutputPlanes, int kernelSize,
+		const float *weightData, const float *biasData) :
+		nInputPlanes(nInputPlanes), nOutputPlanes(nOutputPlanes),
+		kernelSize(kernelSize) {
+
+	int kernelElements = kernelSize * kernelSize;
+	weights.reserve(nInputPlanes * nOutputPlanes);
+	for (int index = 0; index < nInputPlanes * nOutputPlanes; index++) {
+		cv::Mat weightMatrix(kernelSize, kernelSize, CV_32FC1);
+		for (int r = 0; r < kernelSize; r++) {
+			std::copy(weightData + index * kernelElements + r * kernelSize,
+					weightData + index * kernelElements + (r + 1) * kernelSize,
+					weightMatrix.ptr<float>(r));
+		}
+		weights.push_back(weightMatrix);
+	}
+	biases.assign(biasData, biasData + nOutputPlanes);
+
+	packWeights();
+	setDefaultExecution();
+}
+
 int Model::getNInputPlanes() {
 	return nInputPlanes;
 }
@@ -23,107 +51,675 @@ int Model::getNOutputPlanes() {
 	return nOutputPlanes;
 }
 
-bool Model::filter(std::vector<cv::Mat> &inputPlanes,
-		std::vector<cv::Mat> &outputPlanes) {
+int Model::getKernelSize() {
+	return kernelSize;
+}
+
+FilterBackend Model::getBackend() {
+	return backend;
+}
+
+bool Model::setBackend(FilterBackend setBackend) {
+	// GEMM and Winograd backend support only 3x3 kernel
+	if (setBackend != FilterBackend::Direct && kernelSize != 3)
+		return false;
+	backend = setBackend;
+	return true;
+}
+
+int Model::getTasksPerThread() {
+	return tasksPerThread;
+}
+
+bool Model::setTasksPerThread(int setTasksPerThread) {
+	if (setTasksPerThread < 1)
+		return false;
+	tasksPerThread = setTasksPerThread;
+	return true;
+}
+
+bool Model::setInt8Quantization(const ActivationRange &inputRange) {
+	if (kernelSize != 3)
+		return false;
+	int8Weights.quantize(flatWeights.data(), biases, nInputPlanes,
+			nOutputPlanes, inputRange);
+	return true;
+}
+
+void Model::clearInt8Quantization() {
+	int8Weights.clear();
+}
+
+bool Model::isInt8() {
+	return !int8Weights.empty();
+}
+
+// quantize rows [beginningRow, endRow) of input (rows -1 and height are halo)
+// quantizedInput : pixel 0 of row 0
+static void quantizeTensorRows(const ActivationTensor &input,
+		const QuantizationParams &params, int beginningRow, int endRow,
+		uint8_t *quantizedInput, int quantizedRowBytes) {
+	std::vector<const float *> blockRows(input.getNBlocks());
+	for (int y = beginningRow; y < endRow; y++) {
+		for (int ipBlock = 0; ipBlock < input.getNBlocks(); ipBlock++) {
+			blockRows[ipBlock] = input.ptr(ipBlock, y);
+		}
+		quantizeRow(blockRows.data(), input.getNChannels(), input.size().width,
+				params, quantizedInput + y * quantizedRowBytes);
+	}
+}
+
+// set 3 row pointers (upper, center, lower) per input channel block for row y
+// (rows outside of the tensor are in its halo)
+static void setInputBlockRows(const ActivationTensor &input, int y,
+		std::vector<const float *> &inputRows) {
+	for (int ipBlock = 0; ipBlock < input.getNBlocks(); ipBlock++) {
+		for (int k = 0; k < 3; k++) {
+			inputRows[ipBlock * 3 + k] = input.ptr(ipBlock, y - 1 + k);
+		}
+	}
+}
+
+// set 3 row pointers (upper, center, lower) per input plane for row y
+// (pixels of a row are tensorChannelBlock floats apart)
+static void setInputPlaneRows(const ActivationTensor &input, int y,
+		std::vector<const float *> &inputRows) {
+	for (int ipIndex = 0; ipIndex < input.getNChannels(); ipIndex++) {
+		for (int k = 0; k < 3; k++) {
+			inputRows[ipIndex * 3 + k] = input.ptr(
+					ipIndex / tensorChannelBlock, y - 1 + k)
+					+ ipIndex % tensorChannelBlock;
+		}
+	}
+}
+
+// upper limit of patch matrix size of GEMM backend per thread (in elements)
+static constexpr int gemmPatchBudget = 1 << 20;
+
+// patch matrix of rows [beginningRow, beginningRow + nRows) of input
+// (column (y - beginningRow) * width + x for pixel x of row y)
+static void buildPatches(const ActivationTensor &input, int beginningRow,
+		int nRows, float *patches, int ldPatches) {
+	int width = input.size().width;
+	std::vector<const float *> inputRows(input.getNChannels() * 3);
+	for (int y = beginningRow; y < beginningRow + nRows; y++) {
+		setInputPlaneRows(input, y, inputRows);
+		im2colRow3x3(inputRows.data(), input.getNChannels(), width,
+				tensorChannelBlock,
+				patches + (y - beginningRow) * width, ldPatches);
+	}
+}
+
+// 2D decomposition of a layer : (output plane groups) x (row bands)
+// (output planes are counted in units, see Model::filter)
+struct FilterDecomposition {
+	int opsPerGroup;
+	int nGroups;
+	int rowsPerBand;
+	int nBands;
+};
+
+static FilterDecomposition decomposeFilter(int nOpUnits, int nRowUnits,
+		int nTasks, bool splitRowsFirst) {
+	FilterDecomposition dec;
+
+	if (splitRowsFirst) {
+		dec.nBands = std::min(nRowUnits, nTasks);
+		dec.nGroups = std::min(nOpUnits,
+				(nTasks + dec.nBands - 1) / dec.nBands);
+	} else {
+		dec.nGroups = std::min(nOpUnits, nTasks);
+		dec.nBands = std::min(nRowUnits,
+				(nTasks + dec.nGroups - 1) / dec.nGroups);
+	}
+
+	// make groups and bands even (no remainder task)
+	dec.opsPerGroup = (nOpUnits + dec.nGroups - 1) / dec.nGroups;
+	dec.nGroups = (nOpUnits + dec.opsPerGroup - 1) / dec.opsPerGroup;
+	dec.rowsPerBand = (nRowUnits + dec.nBands - 1) / dec.nBands;
+	dec.nBands = (nRowUnits + dec.rowsPerBand - 1) / dec.rowsPerBand;
+
+	return dec;
+}
+
+bool Model::filter(ActivationTensor &input, ActivationTensor &output,
+		bool parallel) {
+	return filter(input, output,
+			parallel ? &modelUtility::getInstance().getThreadPool() : nullptr);
+}
+
+bool Model::filter(ActivationTensor &input, ActivationTensor &output,
+		ThreadPool *pool) {
 
-	if (inputPlanes.size() != nInputPlanes) {
-		std::cerr << "Error : Model-filter : \n"
-				"number of input planes mismatch." << std::endl;
-		std::cerr << inputPlanes.size() << ","
-				<< nInputPlanes << std::endl;
+	if (input.getNChannels() != nInputPlanes) {
+		reportError("Model-filter : number of input planes mismatch ("
+				+ std::to_string(input.getNChannels()) + ","
+				+ std::to_string(nInputPlanes) + ")");
 		return false;
 	}
 
-	outputPlanes.clear();
-	for (int i = 0; i < nOutputPlanes; i++) {
-		outputPlanes.push_back(cv::Mat::zeros(inputPlanes[0].size(), CV_32FC1));
+	if (input.getPrecision() == ActivationPrecision::Half) {
+		return filterHalf(input, output, pool);
 	}
 
-	int nJob = modelUtility::getInstance().getNumberOfJobs();
+	cv::Size ipSize = input.size();
+	bool parallel = (pool != nullptr);
+	int nJob = parallel ? pool->getNumberOfThreads() : 1;
+
+	// INT8 mode : input is quantized once for the layer
+	bool int8 = (kernelSize == 3 && !int8Weights.empty());
+	int quantizedRowBytes = (ipSize.width + 2)
+			* getInt8PixelBytes(nInputPlanes);
+	AlignedBuffer<uint8_t> quantizedBuffer;
+	uint8_t *quantizedInput = nullptr;
+	if (int8) {
+		quantizedBuffer.resize(quantizedRowBytes * (ipSize.height + 2));
+		quantizedInput = quantizedBuffer.data() + quantizedRowBytes
+				+ getInt8PixelBytes(nInputPlanes);
+		int nBands = parallel ? std::min(ipSize.height + 2, nJob) : 1;
+		int rowsPerBand = (ipSize.height + 2 + nBands - 1) / nBands;
+		std::function<void(int)> quantizeTask = [&](int idx) {
+			int beginningRow = -1 + idx * rowsPerBand;
+			quantizeTensorRows(input, int8Weights.getInputParams(),
+					beginningRow,
+					std::min(beginningRow + rowsPerBand, ipSize.height + 1),
+					quantizedInput, quantizedRowBytes);
+		};
+		if (parallel) {
+			pool->parallelFor(nBands, quantizeTask);
+		} else {
+			quantizeTask(0);
+		}
+	}
+
+	// cv::filter2D path works on separate planes
+	std::vector<cv::Mat> inputPlanes;
+	std::vector<cv::Mat> outputPlanes;
+	if (kernelSize == 3) {
+		// every pixel is written by filterWorker
+		output = ActivationTensor(nOutputPlanes, ipSize);
+	} else {
+		input.toPlanes(inputPlanes);
+		for (int i = 0; i < nOutputPlanes; i++) {
+			outputPlanes.push_back(cv::Mat(ipSize, CV_32FC1));
+		}
+	}
 
 	// filter job issuing
-	std::vector<std::thread> workerThreads;
-	int worksPerThread = nOutputPlanes / nJob;
-	for (int idx = 0; idx < nJob; idx++) {
-		if (!(idx == (nJob - 1) && worksPerThread * nJob != nOutputPlanes)) {
-			workerThreads.push_back(
-					std::thread(&Model::filterWorker, this,
-							std::ref(inputPlanes), std::ref(weights),
-							std::ref(outputPlanes),
-							static_cast<unsigned int>(worksPerThread * idx),
-							static_cast<unsigned int>(worksPerThread)));
+	// the layer is divided into (output plane groups) x (row bands), so that
+	// layers with few output planes (like 128->1) also use all threads.
+	// tasks are taken dynamically by free threads.
+	int nRowUnits = ipSize.height;
+	int opUnit = 1;
+	bool splitRowsFirst = false;
+	if (int8) {
+		// INT8 kernel computes blocks of output planes like direct kernel
+		opUnit = weightBlockSize * filterRowBlocks;
+	} else if (backend == FilterBackend::GEMM) {
+		// patch matrix of a band is shared by all output planes
+		splitRowsFirst = true;
+	} else if (backend == FilterBackend::Winograd) {
+		// Winograd backend works on rows of 4x4 tiles
+		nRowUnits = (ipSize.height + winogradTileSize - 1) / winogradTileSize;
+		splitRowsFirst = true;
+	} else if (kernelSize == 3) {
+		// direct kernel computes blocks of packed output planes at once
+		opUnit = weightBlockSize * filterRowBlocks;
+	} else {
+		// cv::filter2D path works on whole planes
+		nRowUnits = 1;
+	}
+	FilterDecomposition dec = decomposeFilter(
+			(nOutputPlanes + opUnit - 1) / opUnit, nRowUnits,
+			parallel ? nJob * tasksPerThread : 1, splitRowsFirst);
+
+	// GEMM tasks of all output plane groups of a band share the patch
+	// matrix of the band, which is built once before them
+	// (in chunks of bands, within the patch budget of the threads)
+	bool sharePatches = parallel && !int8 && kernelSize == 3
+			&& backend == FilterBackend::GEMM && dec.nGroups > 1;
+	std::size_t bandPatchElements = static_cast<std::size_t>(nInputPlanes)
+			* 9 * dec.rowsPerBand * ipSize.width;
+	int bandsPerChunk = dec.nBands;
+	if (sharePatches) {
+		bandsPerChunk = static_cast<int>(std::max<std::size_t>(1,
+				std::min<std::size_t>(dec.nBands,
+						static_cast<std::size_t>(gemmPatchBudget) * nJob
+								/ bandPatchElements)));
+	}
+	std::vector<float> sharedPatches(
+			sharePatches ? bandPatchElements * bandsPerChunk : 0);
+	int chunkBegin = 0;
+	int nChunkBands = dec.nBands;
+
+	std::function<void(int)> task = [&](int idx) {
+		int opBegin = (idx / nChunkBands) * dec.opsPerGroup * opUnit;
+		int nOps = std::min(dec.opsPerGroup * opUnit, nOutputPlanes - opBegin);
+		int rowBegin = (chunkBegin + idx % nChunkBands) * dec.rowsPerBand;
+		int nRows = std::min(dec.rowsPerBand, nRowUnits - rowBegin);
+
+		if (kernelSize != 3) {
+			filterWorkerGeneric(inputPlanes, weights, outputPlanes, opBegin,
+					nOps);
+			return;
+		}
+		if (int8) {
+			filterWorkerInt8(quantizedInput, quantizedRowBytes, output,
+					opBegin, nOps, rowBegin, nRows);
+			return;
+		}
+
+		switch (backend) {
+		case FilterBackend::GEMM:
+			filterWorkerGEMM(input, output, opBegin, nOps, rowBegin, nRows,
+					sharePatches ? sharedPatches.data()
+							+ (idx % nChunkBands) * bandPatchElements
+							: nullptr);
+			break;
+		case FilterBackend::Winograd:
+			filterWorkerWinograd(input, output, opBegin, nOps, rowBegin,
+					nRows);
+			break;
+		default:
+			filterWorker(input, output, opBegin, nOps, rowBegin, nRows);
+			break;
+		}
+	};
+
+	if (sharePatches) {
+		for (; chunkBegin < dec.nBands; chunkBegin += bandsPerChunk) {
+			nChunkBands = std::min(bandsPerChunk, dec.nBands - chunkBegin);
+			pool->parallelFor(nChunkBands, [&](int index) {
+				int rowBegin = (chunkBegin + index) * dec.rowsPerBand;
+				int nRows = std::min(dec.rowsPerBand, nRowUnits - rowBegin);
+				buildPatches(input, rowBegin, nRows,
+						sharedPatches.data() + index * bandPatchElements,
+						nRows * ipSize.width);
+			});
+			pool->parallelFor(dec.nGroups * nChunkBands, task);
+		}
+	} else if (parallel) {
+		pool->parallelFor(dec.nGroups * dec.nBands, task);
+	} else {
+		task(0);
+	}
+
+	if (kernelSize != 3) {
+		output = ActivationTensor::fromPlanes(outputPlanes);
+	} else {
+		output.fillHalo();
+	}
+
+	return true;
+}
+
+// float working set of a band in Model::filterHalf (about the size of L2)
+static constexpr int halfBandCacheBudget = 1 << 20;
+
+bool Model::filterHalf(ActivationTensor &input, ActivationTensor &output,
+		ThreadPool *pool) {
+
+	// kernels work on float, so each band of rows is converted to float,
+	// filtered, and converted back to half.
+	// float band stays in cache, and full planes in memory are half.
+	cv::Size ipSize = input.size();
+	bool parallel = (pool != nullptr);
+	int nJob = parallel ? pool->getNumberOfThreads() : 1;
+
+	int bytesPerRow = (nInputPlanes + nOutputPlanes) * ipSize.width
+			* static_cast<int>(sizeof(float));
+	int bandRows = std::max(halfBandCacheBudget / std::max(bytesPerRow, 1),
+			parallel ? nJob : 1);
+	bandRows = std::min(bandRows, ipSize.height);
+
+	output = ActivationTensor(nOutputPlanes, ipSize, ActivationPrecision::Half);
+	// with 1 row above and below the band (from input halo at borders)
+	ActivationTensor bandInput(nInputPlanes,
+			cv::Size(ipSize.width, bandRows + 2));
+	ActivationTensor bandOutput;
+
+	auto convertRows = [&](const ActivationTensor &src, int srcRow,
+			ActivationTensor &dst, int dstRow, int nRows) {
+		if (parallel) {
+			pool->parallelFor(nRows, [&](int y) {
+				ActivationTensor::convertRows(src, srcRow + y, dst, dstRow + y, 1);
+			});
+		} else {
+			ActivationTensor::convertRows(src, srcRow, dst, dstRow, nRows);
+		}
+	};
+
+	for (int y0 = 0; y0 < ipSize.height; y0 += bandRows) {
+		int nRows = std::min(bandRows, ipSize.height - y0);
+
+		convertRows(input, y0 - 1, bandInput, 0, nRows + 2);
+		ActivationTensor bandInputRegion = bandInput.roi(
+				cv::Rect(0, 1, ipSize.width, nRows));
+		if (!filter(bandInputRegion, bandOutput, pool)) {
+			return false;
+		}
+		convertRows(bandOutput, 0, output, y0, nRows);
+	}
+
+	output.fillHalo();
+	return true;
+}
+
+bool Model::filterRows(const float * const *inputRows,
+		float * const *outputRows, int nRows, int width, bool parallel) {
+	return filterRows(inputRows, outputRows, nRows, width,
+			parallel ? &modelUtility::getInstance().getThreadPool() : nullptr);
+}
+
+bool Model::filterRows(const float * const *inputRows,
+		float * const *outputRows, int nRows, int width, ThreadPool *pool) {
+
+	if (kernelSize != 3) {
+		reportError("Model-filterRows : only 3x3 kernel is supported");
+		return false;
+	}
+
+	auto runTasks = [&](int nTasks, const std::function<void(int)> &task) {
+		if (pool != nullptr) {
+			pool->parallelFor(nTasks, task);
+		} else {
+			for (int idx = 0; idx < nTasks; idx++) {
+				task(idx);
+			}
+		}
+	};
+
+	int nInputBlocks = (nInputPlanes + tensorChannelBlock - 1)
+			/ tensorChannelBlock;
+	int nBlocks = packedWeights.getNumberOfBlocks();
+	int nGroups = (nBlocks + filterRowBlocks - 1) / filterRowBlocks;
+
+	// INT8 mode : 3 input rows of each output row are quantized first
+	// (rows are not known to be shared between output rows)
+	bool int8 = !int8Weights.empty();
+	int quantizedRowBytes = (width + 2) * getInt8PixelBytes(nInputPlanes);
+	AlignedBuffer<uint8_t> quantizedBuffer;
+	std::vector<const uint8_t *> quantizedRows;
+	if (int8) {
+		quantizedBuffer.resize(quantizedRowBytes * nRows * 3);
+		quantizedRows.resize(nRows * 3);
+		for (int i = 0; i < nRows * 3; i++) {
+			quantizedRows[i] = quantizedBuffer.data() + i * quantizedRowBytes
+					+ getInt8PixelBytes(nInputPlanes);
+		}
+		runTasks(nRows * 3, [&](int idx) {
+			int row = idx / 3;
+			int k = idx % 3;
+			std::vector<const float *> blockRows(nInputBlocks);
+			for (int ipBlock = 0; ipBlock < nInputBlocks; ipBlock++) {
+				blockRows[ipBlock] = inputRows[(row * nInputBlocks + ipBlock)
+						* 3 + k];
+			}
+			quantizeRow(blockRows.data(), nInputPlanes, width,
+					int8Weights.getInputParams(),
+					quantizedBuffer.data() + idx * quantizedRowBytes
+							+ getInt8PixelBytes(nInputPlanes));
+		});
+	}
+
+	// one task per (group of filterRowBlocks output blocks, row)
+	runTasks(nRows * nGroups, [&](int idx) {
+		int row = idx / nGroups;
+		int ob = (idx % nGroups) * filterRowBlocks;
+		int n = std::min(filterRowBlocks, nBlocks - ob);
+		if (int8) {
+			filterRow3x3Int8(quantizedRows.data() + row * 3, int8Weights, ob,
+					n, outputRows + row * nBlocks + ob, width);
 		} else {
-			// worksPerThread * nJob != nOutputPlanes
-			workerThreads.push_back(
-					std::thread(&Model::filterWorker, this,
-							std::ref(inputPlanes), std::ref(weights),
-							std::ref(outputPlanes),
-							static_cast<unsigned int>(worksPerThread * idx),
-							static_cast<unsigned int>(nOutputPlanes
-									- worksPerThread * idx)));
+			filterRowKernel(inputRows + row * nInputBlocks * 3,
+					nInputPlanes, packedWeights, ob, n,
+					outputRows + row * nBlocks + ob, width);
 		}
+	});
+
+	return true;
+}
+
+bool Model::canFilterUpsampled2x() {
+	return !upsampledWeights.empty() && int8Weights.empty();
+}
+
+// floor of a / 2 (also for negative a)
+static inline int floorHalf(int a) {
+	return a >= 0 ? a / 2 : -((1 - a) / 2);
+}
+
+bool Model::filterUpsampled2x(const cv::Mat &input, int padding,
+		cv::Rect region, ActivationTensor &output, ThreadPool *pool) {
+
+	if (!canFilterUpsampled2x()) {
+		reportError("Model-filterUpsampled2x : "
+				"only 3x3 kernel of 1 input plane is supported");
+		return false;
+	}
+
+	constexpr int C = tensorChannelBlock;
+	int nBlocks = packedWeights.getNumberOfBlocks();
+	int nPaddedPlanes = nBlocks * C;
+	const float *biases = packedWeights.getBiases();
+
+	// pixel of padded upscaled plane (clamped to region, like the halo of
+	// fromPlane()) -> pixel of input, and phase of the pixel
+	auto mapCoordinate = [padding](int v, int begin, int length,
+			int inputLength, int &inputIndex) {
+		v = std::min(std::max(v, begin), begin + length - 1);
+		inputIndex = std::min(std::max(floorHalf(v - padding), 0),
+				inputLength - 1);
+	};
+
+	// input columns (left and right of 2x2) and phase of each output column
+	std::vector<int> columns(region.width * 2);
+	std::vector<int> columnPhases(region.width);
+	for (int x = 0; x < region.width; x++) {
+		int v = region.x + x;
+		mapCoordinate(v - 1, region.x, region.width, input.cols,
+				columns[x * 2]);
+		mapCoordinate(v + 1, region.x, region.width, input.cols,
+				columns[x * 2 + 1]);
+		columnPhases[x] = (v - padding) - floorHalf(v - padding) * 2;
 	}
-	// wait for finishing jobs
-	for (auto& th : workerThreads) {
-		th.join();
+
+	output = ActivationTensor(nOutputPlanes, region.size());
+
+	auto filterRowsTask = [&](int beginningRow, int endRow) {
+		for (int y = beginningRow; y < endRow; y++) {
+			int v = region.y + y;
+			int top, bottom;
+			mapCoordinate(v - 1, region.y, region.height, input.rows, top);
+			mapCoordinate(v + 1, region.y, region.height, input.rows, bottom);
+			int phaseY = (v - padding) - floorHalf(v - padding) * 2;
+			const float *topRow = input.ptr<float>(top);
+			const float *bottomRow = input.ptr<float>(bottom);
+
+			for (int b = 0; b < nBlocks; b++) {
+				float *outputRow = output.ptr(b, y);
+				for (int x = 0; x < region.width; x++) {
+					const float *w = upsampledWeights.data()
+							+ (phaseY * 2 + columnPhases[x]) * 4 * nPaddedPlanes
+							+ b * C;
+					float in00 = topRow[columns[x * 2]];
+					float in01 = topRow[columns[x * 2 + 1]];
+					float in10 = bottomRow[columns[x * 2]];
+					float in11 = bottomRow[columns[x * 2 + 1]];
+					for (int lane = 0; lane < C; lane++) {
+						float sum = biases[b * C + lane]
+								+ w[lane] * in00
+								+ w[nPaddedPlanes + lane] * in01
+								+ w[2 * nPaddedPlanes + lane] * in10
+								+ w[3 * nPaddedPlanes + lane] * in11;
+						outputRow[x * C + lane] =
+								sum > 0.0f ? sum : sum * 0.1f;
+					}
+				}
+			}
+		}
+	};
+
+	int nTasks = (pool != nullptr) ?
+			std::max(std::min(region.height,
+					pool->getNumberOfThreads() * tasksPerThread), 1) : 1;
+	int rowsPerTask = (region.height + nTasks - 1) / nTasks;
+	auto task = [&](int idx) {
+		int beginningRow = idx * rowsPerTask;
+		filterRowsTask(beginningRow,
+				std::min(beginningRow + rowsPerTask, region.height));
+	};
+	if (pool != nullptr) {
+		pool->parallelFor(nTasks, task);
+	} else {
+		task(0);
 	}
 
+	output.fillHalo();
 	return true;
 }
 
-bool Model::loadModelFromJSONObject(picojson::object &jsonObj) {
+void Model::packWeights() {
 
-	// nInputPlanes,nOutputPlanes,kernelSize have already set.
+	// packing weights for direct, GEMM and Winograd backend
+	if (kernelSize == 3) {
+		int K = nInputPlanes * 9;
+		flatWeights.resize(nOutputPlanes * K);
+		for (int opIndex = 0; opIndex < nOutputPlanes; opIndex++) {
+			for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+				cv::Mat &weightMatrix = weights[opIndex * nInputPlanes + ipIndex];
+				for (int r = 0; r < 3; r++) {
+					std::copy(weightMatrix.ptr<float>(r),
+							weightMatrix.ptr<float>(r) + 3,
+							flatWeights.begin() + opIndex * K + ipIndex * 9
+									+ r * 3);
+				}
+			}
+		}
 
-	int matProgress = 0;
-	picojson::array &wOutputPlane = jsonObj["weight"].get<picojson::array>();
+		packedWeights.pack(flatWeights.data(), biases, nInputPlanes,
+				nOutputPlanes);
 
-	// setting weight matrices
-	for (auto&& wInputPlaneV : wOutputPlane) {
-		picojson::array &wInputPlane = wInputPlaneV.get<picojson::array>();
+		winogradWeights.resize(winogradElements * nOutputPlanes * nInputPlanes);
+		winogradTransformWeights(flatWeights.data(), nInputPlanes,
+				nOutputPlanes, winogradWeights.data());
 
-		for (auto&& weightMatV : wInputPlane) {
-			picojson::array &weightMat = weightMatV.get<picojson::array>();
-			cv::Mat writeMatrix = cv::Mat::zeros(kernelSize, kernelSize,
-			CV_32FC1);
+		if (nInputPlanes == 1) {
+			packUpsampledWeights();
+		}
+	}
+
+}
+
+void Model::packUpsampledWeights() {
 
-			for (int writingRow = 0; writingRow < kernelSize; writingRow++) {
-				auto& weightMatRowV = weightMat.at(writingRow);
-				picojson::array &weightMatRow = weightMatRowV.get<
-						picojson::array>();
+	// taps of a row (or column) of 3x3 kernel merged into 2 taps, for the
+	// phase of the output pixel in 2x upscaled plane
+	//  phase 0 (first copy)  : input -1 <- tap 0, input 0 <- taps 1, 2
+	//  phase 1 (second copy) : input 0 <- taps 0, 1, input +1 <- tap 2
+	static const int mergedTap[2][3] = { { 0, 1, 1 }, { 0, 0, 1 } };
 
-				for (int index = 0; index < kernelSize; index++) {
-					writeMatrix.at<float>(writingRow, index) =
-							weightMatRow[index].get<double>();
-				} // for(weightMatRow) (writing 1 row finished)
+	int nPaddedPlanes = packedWeights.getNumberOfBlocks() * weightBlockSize;
+	upsampledWeights.assign(16 * nPaddedPlanes, 0.0f);
+	for (int phaseY = 0; phaseY < 2; phaseY++) {
+		for (int phaseX = 0; phaseX < 2; phaseX++) {
+			float *phaseWeights = upsampledWeights.data()
+					+ (phaseY * 2 + phaseX) * 4 * nPaddedPlanes;
+			for (int opIndex = 0; opIndex < nOutputPlanes; opIndex++) {
+				for (int r = 0; r < 3; r++) {
+					for (int c = 0; c < 3; c++) {
+						int tap = mergedTap[phaseY][r] * 2
+								+ mergedTap[phaseX][c];
+						phaseWeights[tap * nPaddedPlanes + opIndex] +=
+								flatWeights[opIndex * 9 + r * 3 + c];
+					}
+				}
+			}
+		}
+	}
 
-			} // for(weightMat) (writing 1 matrix finished)
+}
 
-			weights.at(matProgress) = std::move(writeMatrix);
-			matProgress++;
-		} // for(wInputPlane) (writing matrices in set of wInputPlane finished)
+void Model::setDefaultExecution() {
 
-	} //for(wOutputPlane) (writing all matrices finished)
+	tasksPerThread = defaultTasksPerThread;
+	filterRowKernel = findFilterRowKernel(nInputPlanes, nOutputPlanes,
+			kernelSize);
 
-	// setting biases
-	picojson::array biasesData = jsonObj["bias"].get<picojson::array>();
-	for (int index = 0; index < nOutputPlanes; index++) {
-		biases[index] = biasesData[index].get<double>();
+	// wide layers are lowered to matrix multiply,
+	// narrow ones (like 1->32 or 128->1) keep the direct kernel
+	if (kernelSize == 3 && nInputPlanes >= 32 && nOutputPlanes >= 32) {
+		backend = FilterBackend::GEMM;
+	} else {
+		backend = FilterBackend::Direct;
 	}
 
+}
+
+bool Model::filterWorker(const ActivationTensor &input,
+		ActivationTensor &output, unsigned int beginningIndex,
+		unsigned int nWorks, unsigned int beginningRow, unsigned int nRows) {
+
+	// fused 3x3 kernel : all input planes are accumulated per output tile
+	// for a block of output planes, and bias + LeakyReLU are applied
+	// in the same pass
+	// (beginningIndex is a multiple of weightBlockSize)
+	int width = input.size().width;
+	int beginningBlock = beginningIndex / weightBlockSize;
+	int nBlocks = (nWorks + weightBlockSize - 1) / weightBlockSize;
+	std::vector<const float *> inputRows(input.getNBlocks() * 3);
+	std::vector<float *> outputRows(nBlocks);
+	int endRow = beginningRow + nRows;
+
+	for (int y = beginningRow; y < endRow; y++) {
+		setInputBlockRows(input, y, inputRows);
+		for (int i = 0; i < nBlocks; i++) {
+			outputRows[i] = output.ptr(beginningBlock + i, y);
+		}
+		filterRowKernel(inputRows.data(), nInputPlanes, packedWeights,
+				beginningBlock, nBlocks, outputRows.data(), width);
+	} // for y
+
 	return true;
 }
 
-bool Model::filterWorker(std::vector<cv::Mat> &inputPlanes,
+bool Model::filterWorkerInt8(const uint8_t *quantizedInput,
+		int quantizedRowBytes, ActivationTensor &output,
+		unsigned int beginningIndex, unsigned int nWorks,
+		unsigned int beginningRow, unsigned int nRows) {
+
+	// same as filterWorker, on quantized input
+	int width = output.size().width;
+	int beginningBlock = beginningIndex / weightBlockSize;
+	int nBlocks = (nWorks + weightBlockSize - 1) / weightBlockSize;
+	const uint8_t *inputRows[3];
+	std::vector<float *> outputRows(nBlocks);
+	int endRow = beginningRow + nRows;
+
+	for (int y = beginningRow; y < endRow; y++) {
+		for (int k = 0; k < 3; k++) {
+			inputRows[k] = quantizedInput + (y - 1 + k) * quantizedRowBytes;
+		}
+		for (int i = 0; i < nBlocks; i++) {
+			outputRows[i] = output.ptr(beginningBlock + i, y);
+		}
+		filterRow3x3Int8(inputRows, int8Weights, beginningBlock, nBlocks,
+				outputRows.data(), width);
+	} // for y
+
+	return true;
+}
+
+bool Model::filterWorkerGeneric(std::vector<cv::Mat> &inputPlanes,
 		std::vector<cv::Mat> &weightMatrices,
 		std::vector<cv::Mat> &outputPlanes, unsigned int beginningIndex,
 		unsigned int nWorks) {
-	cv::ocl::setUseOpenCL(false); // disable OpenCL Support(temporary)
-
 	cv::Size ipSize = inputPlanes[0].size();
 	// filter processing
 	// input : inputPlanes
 	// kernel : weightMatrices
+	cv::ocl::setUseOpenCL(false); // disable OpenCL Support(temporary)
+
 	for (int opIndex = beginningIndex; opIndex < (beginningIndex + nWorks);
 			opIndex++) {
 
@@ -158,23 +754,184 @@ bool Model::filterWorker(std::vector<cv::Mat> &inputPlanes,
 	return true;
 }
 
-modelUtility * modelUtility::instance = nullptr;
+bool Model::filterWorkerGEMM(const ActivationTensor &input,
+		ActivationTensor &output, unsigned int beginningIndex,
+		unsigned int nWorks, unsigned int beginningRow, unsigned int nRows,
+		const float *sharedPatches) {
+
+	constexpr int C = tensorChannelBlock;
+	int width = input.size().width;
+	int K = nInputPlanes * 9;
+	int bandRows = std::max(1, gemmPatchBudget / (K * width));
+
+	std::vector<float> patches(sharedPatches ? 0 : K * bandRows * width);
+	std::vector<float> gemmOutput(nWorks * bandRows * width);
+	int endRow = beginningRow + nRows;
+
+	for (int y0 = beginningRow; y0 < endRow; y0 += bandRows) {
+		int nBandRows = std::min(bandRows, endRow - y0);
+		int N = nBandRows * width;
+
+		const float *bandPatches;
+		int ldPatches;
+		if (sharedPatches) {
+			bandPatches = sharedPatches + (y0 - beginningRow) * width;
+			ldPatches = nRows * width;
+		} else {
+			buildPatches(input, y0, nBandRows, patches.data(), N);
+			bandPatches = patches.data();
+			ldPatches = N;
+		}
+
+		// rows of weight matrix for output planes of this task
+		sgemmBlocked(nWorks, N, K, flatWeights.data() + beginningIndex * K, K,
+				bandPatches, ldPatches, gemmOutput.data(), N);
+
+		int endIndex = beginningIndex + nWorks;
+		for (int opIndex = beginningIndex; opIndex < endIndex; opIndex++) {
+			for (int y = y0; y < y0 + nBandRows; y++) {
+				biasLeakyReLU(gemmOutput.data()
+						+ (opIndex - beginningIndex) * N + (y - y0) * width,
+						packedWeights.getBiases()[opIndex],
+						output.ptr(opIndex / C, y) + opIndex % C, width, C);
+			}
+		}
+
+	} // for y0
+
+	return true;
+}
+
+bool Model::filterWorkerWinograd(const ActivationTensor &input,
+		ActivationTensor &output, unsigned int beginningIndex,
+		unsigned int nWorks, unsigned int beginningTileRow,
+		unsigned int nTileRows) {
+
+	constexpr int C = tensorChannelBlock;
+	cv::Size ipSize = input.size();
+	int nTiles = (ipSize.width + winogradTileSize - 1) / winogradTileSize;
+
+	std::vector<float> V(winogradElements * nInputPlanes * nTiles);
+	std::vector<float> M(winogradElements * nWorks * nTiles);
+	std::vector<const float *> inputRows(nInputPlanes * winogradInputTileSize);
+	std::vector<float *> outputRows(nWorks * winogradTileSize);
+	int endTileRow = beginningTileRow + nTileRows;
+
+	for (int tileRow = beginningTileRow; tileRow < endTileRow; tileRow++) {
+		int y0 = tileRow * winogradTileSize;
+		int nRows = std::min(winogradTileSize, ipSize.height - y0);
+
+		// 6 input rows (y0 - 1 to y0 + 4), halo rows at borders
+		// (input may be a region of larger tensor, so its halo rows are not
+		//  always replicated rows; rows below halo only make unused outputs)
+		for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+			for (int r = 0; r < winogradInputTileSize; r++) {
+				int y = std::min(std::max(y0 - 1 + r, -ActivationTensor::halo),
+						ipSize.height - 1 + ActivationTensor::halo);
+				inputRows[ipIndex * winogradInputTileSize + r] = input.ptr(
+						ipIndex / C, y) + ipIndex % C;
+			}
+		}
+		winogradInputTransformRow(inputRows.data(), nInputPlanes,
+				ipSize.width, C, V.data(), nTiles);
+
+		// rows of transformed weights for output planes of this task
+		for (int e = 0; e < winogradElements; e++) {
+			sgemmBlocked(nWorks, nTiles, nInputPlanes,
+					winogradWeights.data()
+							+ (e * nOutputPlanes + beginningIndex) * nInputPlanes,
+					nInputPlanes, V.data() + e * nInputPlanes * nTiles, nTiles,
+					M.data() + e * nWorks * nTiles, nTiles);
+		}
+
+		for (int opIndex = 0; opIndex < static_cast<int>(nWorks); opIndex++) {
+			int ch = beginningIndex + opIndex;
+			for (int r = 0; r < nRows; r++) {
+				outputRows[opIndex * winogradTileSize + r] = output.ptr(ch / C,
+						y0 + r) + ch % C;
+			}
+		}
+		winogradOutputTransformRow(M.data(), nTiles, nWorks,
+				packedWeights.getBiases() + beginningIndex, outputRows.data(),
+				nRows, ipSize.width, C);
+
+	} // for tileRow
+
+	return true;
+}
 
 modelUtility& modelUtility::getInstance(){
-	if(instance == nullptr){
-		instance = new modelUtility();
-	}
-	return *instance;
+	// initialization of local static is thread-safe
+	static modelUtility utility;
+	return utility;
 }
 
 bool modelUtility::generateModelFromJSON(const std::string &fileName,
 		std::vector<std::unique_ptr<Model> > &models) {
 
+	std::ifstream jsonFile(fileName, std::ios::binary);
+	if (!jsonFile.is_open()) {
+		reportError("couldn't open " + fileName);
+		return false;
+	}
+
+	// weights are read into buffers of a layer, and packed by Model
+	// (no document tree of the whole file)
+	std::string errMsg;
+	bool ret = readJSONModel(jsonFile, [&](const JSONModelLayer &layer) {
+		std::unique_ptr<Model> m = std::unique_ptr<Model>(
+				new Model(layer.nInputPlanes, layer.nOutputPlanes,
+						layer.kernelSize, layer.weights.data(),
+						layer.biases.data()));
+		models.push_back(std::move(m));
+		return true;
+	}, errMsg);
+	if (!ret) {
+		reportError(fileName + " : " + errMsg);
+		return false;
+	}
+
+	return true;
+}
+
+bool modelUtility::generateModelFromBinary(const std::string &fileName,
+		uint64_t sourceHash, std::vector<std::unique_ptr<Model> > &models) {
+
+	MappedFile file;
+	if (!file.open(fileName)) {
+		reportError("couldn't open " + fileName);
+		return false;
+	}
+
+	std::vector<BinaryLayer> layers;
+	uint64_t fileSourceHash;
+	if (!readBinaryModel(file, layers, fileSourceHash)) {
+		reportError("couldn't load " + fileName);
+		return false;
+	}
+	if (fileSourceHash != sourceHash) {
+		reportError(fileName + " is not made from current JSON model");
+		return false;
+	}
+
+	for (auto&& layer : layers) {
+		std::unique_ptr<Model> m = std::unique_ptr<Model>(
+				new Model(layer.nInputPlanes, layer.nOutputPlanes,
+						layer.kernelSize, layer.weights, layer.biases));
+		models.push_back(std::move(m));
+	}
+
+	return true;
+}
+
+bool modelUtility::loadInt8Calibration(const std::string &fileName,
+		std::vector<std::unique_ptr<Model> > &models) {
+
 	std::ifstream jsonFile;
 
 	jsonFile.open(fileName);
 	if (!jsonFile.is_open()) {
-		std::cerr << "Error : couldn't open " << fileName << std::endl;
+		reportError("couldn't open " + fileName);
 		return false;
 	}
 
@@ -182,22 +939,120 @@ bool modelUtility::generateModelFromJSON(const std::string &fileName,
 	jsonFile >> jsonValue;
 	std::string errMsg = picojson::get_last_error();
 	if (!errMsg.empty()) {
-		std::cerr << "Error : PicoJSON Error : " << errMsg << std::endl;
+		reportError("PicoJSON Error : " + errMsg);
 		return false;
 	}
 
+	// the file may be edited by hand, so types are checked
+	if (!jsonValue.is<picojson::array>()) {
+		reportError(fileName + " is not an INT8 calibration file");
+		return false;
+	}
 	picojson::array& objectArray = jsonValue.get<picojson::array>();
-	for (auto&& obj : objectArray) {
-		std::unique_ptr<Model> m = std::unique_ptr<Model>(
-				new Model(obj.get<picojson::object>()));
-		models.push_back(std::move(m));
+	if (objectArray.size() != models.size()) {
+		reportError(fileName + " has " + std::to_string(objectArray.size())
+				+ " layers, but model has " + std::to_string(models.size()));
+		return false;
+	}
+
+	// all ranges are read before any layer is changed
+	std::vector<ActivationRange> inputRanges;
+	for (auto&& value : objectArray) {
+		if (!value.is<picojson::object>()) {
+			reportError(fileName + " is not an INT8 calibration file");
+			return false;
+		}
+		picojson::object &obj = value.get<picojson::object>();
+		if (!obj["inputMin"].is<double>() || !obj["inputMax"].is<double>()) {
+			reportError(fileName + " is not an INT8 calibration file");
+			return false;
+		}
+		ActivationRange range;
+		range.min = static_cast<float>(obj["inputMin"].get<double>());
+		range.max = static_cast<float>(obj["inputMax"].get<double>());
+		inputRanges.push_back(range);
+	}
+
+	for (std::size_t index = 0; index < models.size(); index++) {
+		// layers other than 3x3 stay in float
+		models[index]->setInt8Quantization(inputRanges[index]);
 	}
 
 	return true;
 }
 
+bool modelUtility::saveInt8Calibration(const std::string &fileName,
+		const std::vector<ActivationRange> &inputRanges) {
+
+	picojson::array objectArray;
+	for (auto&& range : inputRanges) {
+		picojson::object obj;
+		obj["inputMin"] = picojson::value(static_cast<double>(range.min));
+		obj["inputMax"] = picojson::value(static_cast<double>(range.max));
+		objectArray.push_back(picojson::value(obj));
+	}
+
+	std::ofstream jsonFile(fileName);
+	if (!jsonFile.is_open()) {
+		reportError("couldn't open " + fileName);
+		return false;
+	}
+	jsonFile << picojson::value(objectArray).serialize(true) << std::endl;
+
+	return true;
+}
+
+// file name without extension
+static std::string removeExtension(const std::string &fileName) {
+	std::string baseName = fileName;
+	std::size_t tailDot = baseName.find_last_of('.');
+	if (tailDot != std::string::npos
+			&& baseName.find_first_of("/\\", tailDot) == std::string::npos) {
+		baseName.erase(tailDot);
+	}
+	return baseName;
+}
+
+std::string modelUtility::getInt8CalibrationFileName(
+		const std::string &modelFileName) {
+	return removeExtension(modelFileName) + ".int8.json";
+}
+
+bool modelUtility::generateModel(std::string &modelFileName,
+		std::vector<std::unique_ptr<Model> > &models) {
+
+	std::string binaryFileName = getBinaryModelFileName(modelFileName);
+	uint64_t sourceHash;
+	if (std::ifstream(binaryFileName).good()
+			&& getFileHash(modelFileName, sourceHash)) {
+		// errors of binary model are not errors of loading
+		std::string binaryErrorMessage;
+		{
+			ErrorCollector binaryErrors;
+			if (generateModelFromBinary(binaryFileName, sourceHash, models)) {
+				modelFileName = binaryFileName;
+				return true;
+			}
+			binaryErrorMessage = binaryErrors.getMessage();
+		}
+		reportWarning(binaryErrorMessage + ", loading " + modelFileName
+				+ " instead (run convertModel to update " + binaryFileName
+				+ ")");
+	}
+
+	return generateModelFromJSON(modelFileName, models);
+}
+
+std::string modelUtility::getBinaryModelFileName(
+		const std::string &modelFileName) {
+	return removeExtension(modelFileName) + ".bin";
+}
+
 bool modelUtility::setNumberOfJobs(int setNJob){
 	if(setNJob < 1)return false;
+	// execution contexts and filter() may use the pool at any time after
+	// it is created, so it is never replaced
+	if(threadPool && setNJob != nJob)return false;
 	nJob = setNJob;
 	return true;
 };
@@ -206,6 +1061,25 @@ int modelUtility::getNumberOfJobs(){
 	return nJob;
 }
 
+ThreadPool& modelUtility::getThreadPool(){
+	if(!threadPool){
+		threadPool = std::unique_ptr<ThreadPool>(new ThreadPool(nJob));
+	}
+	return *threadPool;
+}
+
+ExecutionContext modelUtility::getExecutionContext(){
+	ExecutionContext context;
+	context.threadPool = &getThreadPool();
+	context.blockSize = blockSplittingSize;
+	context.tileFusion = tileFusion;
+	context.tileFusionSize = tileFusionSize;
+	context.streaming = streaming;
+	context.halfActivations = halfActivations;
+	context.verbose = true;
+	return context;
+}
+
 bool modelUtility::setBlockSize(cv::Size size){
 	if(size.width < 0 || size.height < 0)return false;
 	blockSplittingSize = size;
@@ -223,6 +1097,43 @@ cv::Size modelUtility::getBlockSize(){
 	return blockSplittingSize;
 }
 
+bool modelUtility::setTileFusion(bool enable){
+	tileFusion = enable;
+	return true;
+}
+
+bool modelUtility::getTileFusion(){
+	return tileFusion;
+}
+
+bool modelUtility::setTileFusionSize(int size){
+	if(size < 0)return false;
+	tileFusionSize = size;
+	return true;
+}
+
+int modelUtility::getTileFusionSize(){
+	return tileFusionSize;
+}
+
+bool modelUtility::setStreaming(bool enable){
+	streaming = enable;
+	return true;
+}
+
+bool modelUtility::getStreaming(){
+	return streaming;
+}
+
+bool modelUtility::setHalfActivations(bool enable){
+	halfActivations = enable;
+	return true;
+}
+
+bool modelUtility::getHalfActivations(){
+	return halfActivations;
+}
+
 
 // for debugging
 
@@ -14,6 +14,11 @@
 #include <opencv2/opencv.hpp>
 #include <opencv2/core/ocl.hpp>
 #include "picojson.h"
+#include "threadPool.hpp"
+#include "packedWeights.hpp"
+#include "filterKernels.hpp"
+#include "quantization.hpp"
+#include "activationTensor.hpp"
 #include <iostream>
 #include <memory>
 #include <cstdint>
@@ -21,6 +26,20 @@
 
 namespace w2xc {
 
+/**
+ * convolution algorithm used by Model::filter()
+ *  Direct   : fused 3x3 kernel (or cv::filter2D for other kernel sizes)
+ *  GEMM     : im2col + blocked SGEMM (3x3 only)
+ *  Winograd : Winograd F(4x4, 3x3) (3x3 only)
+ */
+enum class FilterBackend {
+	Direct, GEMM, Winograd
+};
+
+// default number of tasks issued per thread by Model::filter
+// (more tasks than threads keep all threads busy with dynamic scheduling)
+constexpr int defaultTasksPerThread = 4;
+
 class Model {
 
 private:
@@ -29,47 +48,76 @@ private:
 	std::vector<cv::Mat> weights;
 	std::vector<double> biases;
 	int kernelSize;
+	FilterBackend backend;
+	int tasksPerThread;
+	// 3x3 weights packed as nOutputPlanes x (9 * nInputPlanes) matrix
+	// (used by GEMM backend)
+	std::vector<float> flatWeights;
+	// 3x3 weights interleaved by blocks of output planes, and float biases
+	// (used by direct row kernel, biases also by GEMM and Winograd backend)
+	PackedWeights packedWeights;
+	// direct row kernel bound to the shape of the layer
+	// (see findFilterRowKernel())
+	FilterRowKernel filterRowKernel;
+	// weights transformed into Winograd domain (36 x nOutputPlanes x nInputPlanes)
+	std::vector<float> winogradWeights;
+	// 8-bit weights (empty unless INT8 mode is set, used instead of backend)
+	QuantizedWeights int8Weights;
+	// 3x3 weights merged into 2x2 for each phase of nearest-neighbour 2x
+	// upscaled input (1 input plane only, see filterUpsampled2x())
+	// [phaseY][phaseX][tap (2x2)][output plane padded to weightBlockSize]
+	std::vector<float> upsampledWeights;
 
 	Model() {
 	}
 	; // cannot use no-argument constructor
 
-	// class inside operation function
-	bool loadModelFromJSONObject(picojson::object& jsonObj);
+	// pack weights for backends (after weights and biases are set)
+	void packWeights();
+	void packUpsampledWeights();
+	// default backend and kernels for the shape of the layer
+	void setDefaultExecution();
 
 	// thread worker function
-	bool filterWorker(std::vector<cv::Mat> &inputPlanes,
+	// (each processes output planes [beginningIndex, beginningIndex + nWorks)
+	//  in rows [beginningRow, beginningRow + nRows))
+	bool filterWorker(const ActivationTensor &input, ActivationTensor &output,
+			unsigned int beginningIndex, unsigned int nWorks,
+			unsigned int beginningRow, unsigned int nRows);
+	// (sharedPatches : patch matrix of rows [beginningRow,
+	//  beginningRow + nRows) shared by tasks of the band, or nullptr to
+	//  build it here)
+	bool filterWorkerGEMM(const ActivationTensor &input,
+			ActivationTensor &output, unsigned int beginningIndex,
+			unsigned int nWorks, unsigned int beginningRow, unsigned int nRows,
+			const float *sharedPatches);
+	// (rows are counted in rows of 4x4 tiles)
+	bool filterWorkerWinograd(const ActivationTensor &input,
+			ActivationTensor &output, unsigned int beginningIndex,
+			unsigned int nWorks, unsigned int beginningTileRow,
+			unsigned int nTileRows);
+	// (quantizedInput : pixel 0 of row 0 of quantized input, see
+	//  quantization.hpp, rows -1 and height are readable)
+	bool filterWorkerInt8(const uint8_t *quantizedInput, int quantizedRowBytes,
+			ActivationTensor &output, unsigned int beginningIndex,
+			unsigned int nWorks, unsigned int beginningRow, unsigned int nRows);
+	// half input and output : converted in bands of rows to float
+	bool filterHalf(ActivationTensor &input, ActivationTensor &output,
+			ThreadPool *pool);
+	// kernel size other than 3x3 (cv::filter2D on separate planes)
+	bool filterWorkerGeneric(std::vector<cv::Mat> &inputPlanes,
 			std::vector<cv::Mat> &weightMatrices,
 			std::vector<cv::Mat> &outputPlanes, unsigned int beginningIndex,
 			unsigned int nWorks);
 
 public:
 	// ctor and dtor
-	Model(picojson::object &jsonObj) {
-		// preload nInputPlanes,nOutputPlanes, and preserve required size vector
-		nInputPlanes = static_cast<int>(jsonObj["nInputPlane"].get<double>());
-		nOutputPlanes = static_cast<int>(jsonObj["nOutputPlane"].get<double>());
-		if ((kernelSize = static_cast<int>(jsonObj["kW"].get<double>()))
-				!= static_cast<int>(jsonObj["kH"].get<double>())) {
-			std::cerr << "Error : Model-Constructor : \n"
-					"kernel in model is not square.\n"
-					"stop." << std::endl;
-			std::exit(-1);
-		} // kH == kW
-
-		weights = std::vector<cv::Mat>(nInputPlanes * nOutputPlanes,
-				cv::Mat(kernelSize, kernelSize, CV_32FC1));
-		biases = std::vector<double>(nOutputPlanes, 0.0);
-
-		if (!loadModelFromJSONObject(jsonObj)) {
-			std::cerr
-					<< "Error : Model-Constructor : \n"
-							"something error has been occured in loading model from JSON-Object.\n"
-							"stop." << std::endl;
-			std::exit(-1);
-		}
-	}
-	;
+	// layer from arrays (binary model, see modelFormat.hpp, or streaming
+	// JSON reader, see jsonModelReader.hpp)
+	// weightData : nOutputPlanes x nInputPlanes x kernelSize x kernelSize
+	// biasData   : nOutputPlanes
+	Model(int nInputPlanes, int nOutputPlanes, int kernelSize,
+			const float *weightData, const float *biasData);
 	~Model() {
 	}
 
@@ -80,35 +128,152 @@ public:
 	// getter function
 	int getNInputPlanes();
 	int getNOutputPlanes();
+	int getKernelSize();
+	FilterBackend getBackend();
+	int getTasksPerThread();
 
 	// setter function
+	bool setBackend(FilterBackend setBackend);
+	// granularity of the split of the layer into tasks
+	bool setTasksPerThread(int setTasksPerThread);
+
+	// INT8 mode (3x3 layer only, returns false otherwise)
+	// inputRange : range of layer input calibrated over sample images
+	bool setInt8Quantization(const ActivationRange &inputRange);
+	void clearInt8Quantization();
+	bool isInt8();
 
 	// public operation function
-	bool filter(std::vector<cv::Mat> &inputPlanes,
-			std::vector<cv::Mat> &outputPlanes);
+	// pool : divide the layer into tasks on the thread pool
+	//        (nullptr : run all on calling thread)
+	// parallel : on the thread pool of modelUtility, or calling thread
+	// (output is allocated in the same size and precision as input,
+	//  with filled halo)
+	// filter() doesn't modify the model, so that a model can be shared by
+	// conversions running at the same time.
+	bool filter(ActivationTensor &input, ActivationTensor &output,
+			ThreadPool *pool);
+	bool filter(ActivationTensor &input, ActivationTensor &output,
+			bool parallel = true);
+
+	// filterUpsampled2x() is available (3x3 layer of 1 input plane, not
+	// in INT8 mode)
+	bool canFilterUpsampled2x();
+	/**
+	 * filter() on region of nearest-neighbour 2x upscaled input, padded by
+	 * padding pixels (replicated), without making the upscaled plane.
+	 * in the upscaled plane, 3 taps of a row (or column) read 2 input
+	 * pixels, so each output pixel reads 2x2 input pixels with 3x3 weights
+	 * merged for its phase (position in 2x2 copies of an input pixel).
+	 * result is the same as filter() on ActivationTensor::fromPlane()
+	 * of region of the padded upscaled plane (except rounding).
+	 * input : CV_32FC1 plane (low resolution)
+	 * (output is float)
+	 */
+	bool filterUpsampled2x(const cv::Mat &input, int padding,
+			cv::Rect region, ActivationTensor &output, ThreadPool *pool);
 
+	/**
+	 * compute nRows rows of all output planes by 3x3 direct kernel
+	 * (3x3 layer only, returns false otherwise).
+	 * rows are in channel-blocked layout of ActivationTensor, and point to
+	 * pixel 0 (pixels -1 and width of input rows must be readable).
+	 * inputRows  : for each row, 3 row pointers per input channel block
+	 *              inputRows[(row * nInputBlocks + ipBlock) * 3 + 0..2]
+	 * outputRows : for each row, 1 row pointer per output channel block
+	 *              outputRows[row * nOutputBlocks + opBlock]
+	 */
+	bool filterRows(const float * const *inputRows, float * const *outputRows,
+			int nRows, int width, ThreadPool *pool);
+	bool filterRows(const float * const *inputRows, float * const *outputRows,
+			int nRows, int width, bool parallel = true);
+
+};
+
+/**
+ * settings of execution of convertWithModels() : thread pool and the way
+ * an image is divided. modelUtility holds the one of command line tools,
+ * and each Converter (see converter.hpp) has its own.
+ */
+struct ExecutionContext {
+	ThreadPool *threadPool;
+	cv::Size blockSize; // of block splitting
+	bool tileFusion; // depth-first execution
+	int tileFusionSize; // (0 : auto)
+	bool streaming;
+	bool halfActivations;
+	bool verbose; // progress messages to std::cout
 };
 
 class modelUtility {
 
 private:
-	static modelUtility* instance;
 	int nJob;
 	cv::Size blockSplittingSize;
+	std::unique_ptr<ThreadPool> threadPool;
+	bool tileFusion;
+	int tileFusionSize;
+	bool streaming;
+	bool halfActivations;
 	modelUtility() :
-			nJob(4), blockSplittingSize(512,512) {
+			nJob(4), blockSplittingSize(512,512), tileFusion(false),
+			tileFusionSize(0), streaming(false), halfActivations(false) {
 	}
 	;
 
 public:
 	static bool generateModelFromJSON(const std::string &fileName,
 			std::vector<std::unique_ptr<Model> > &models);
+	// binary model (see modelFormat.hpp), read without parsing JSON.
+	// fails if it is not made from JSON model whose hash is sourceHash
+	static bool generateModelFromBinary(const std::string &fileName,
+			uint64_t sourceHash,
+			std::vector<std::unique_ptr<Model> > &models);
+	// binary model is placed next to JSON model
+	// (noise1_model.json -> noise1_model.bin)
+	static std::string getBinaryModelFileName(
+			const std::string &modelFileName);
+	// binary model next to JSON model if it is made from this JSON model,
+	// otherwise JSON model (with message if binary model is not used).
+	// modelFileName is set to the loaded file
+	static bool generateModel(std::string &modelFileName,
+			std::vector<std::unique_ptr<Model> > &models);
+	// calibration file of INT8 mode : input range of each layer
+	// (layers other than 3x3 have a range too, but are not quantized)
+	static bool loadInt8Calibration(const std::string &fileName,
+			std::vector<std::unique_ptr<Model> > &models);
+	static bool saveInt8Calibration(const std::string &fileName,
+			const std::vector<ActivationRange> &inputRanges);
+	// calibration file is placed next to model file
+	// (noise1_model.json -> noise1_model.int8.json)
+	static std::string getInt8CalibrationFileName(
+			const std::string &modelFileName);
+	// (first call is thread-safe, but setters are not, so set up before
+	//  starting threads)
 	static modelUtility& getInstance();
+	// only before the thread pool is created by getThreadPool() (or
+	// getExecutionContext()), returns false after that
 	bool setNumberOfJobs(int setNJob);
 	int getNumberOfJobs();
+	ThreadPool& getThreadPool();
+	// settings below and thread pool, for convertWithModels()
+	ExecutionContext getExecutionContext();
 	bool setBlockSize(cv::Size size);
 	bool setBlockSizeExp2Square(int exp);
 	cv::Size getBlockSize();
+	// depth-first execution (all layers per small tile)
+	bool setTileFusion(bool enable);
+	bool getTileFusion();
+	// edge length of output tile in depth-first execution (0 : auto)
+	bool setTileFusionSize(int size);
+	int getTileFusionSize();
+	// streaming execution (ring buffer of rows per layer)
+	bool setStreaming(bool enable);
+	bool getStreaming();
+	// planes between layers are stored in half (basic and block splitting
+	// execution only)
+	bool setHalfActivations(bool enable);
+	bool getHalfActivations();
 
 };
 
@@ -0,0 +1,52 @@
+/*
+ * packedWeights.cpp
+ *   3x3 weights of a layer in one contiguous, SIMD-aligned buffer
+ */
+
+#include "packedWeights.hpp"
+
+namespace w2xc {
+
+void PackedWeights::pack(const float *flatWeights,
+		const std::vector<double> &biasValues, int nInputPlanes,
+		int nOutputPlanes) {
+
+	nPaddedInputPlanes = (nInputPlanes + weightBlockSize - 1) / weightBlockSize
+			* weightBlockSize;
+	nBlocks = (nOutputPlanes + weightBlockSize - 1) / weightBlockSize;
+
+	// zero-cleared : padding planes have zero weights and bias
+	weights.resize(nBlocks * nPaddedInputPlanes * 9 * weightBlockSize);
+	biases.resize(nBlocks * weightBlockSize);
+
+	for (int opIndex = 0; opIndex < nOutputPlanes; opIndex++) {
+		int ob = opIndex / weightBlockSize;
+		int lane = opIndex % weightBlockSize;
+
+		for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+			for (int tap = 0; tap < 9; tap++) {
+				weights[((ob * nPaddedInputPlanes + ipIndex) * 9 + tap)
+						* weightBlockSize + lane] =
+						flatWeights[(opIndex * nInputPlanes + ipIndex) * 9 + tap];
+			}
+		}
+
+		biases[opIndex] = static_cast<float>(biasValues[opIndex]);
+	}
+
+	if (nOutputPlanes < weightBlockSize) {
+		narrowWeights.resize(nOutputPlanes * 9 * nPaddedInputPlanes);
+		for (int opIndex = 0; opIndex < nOutputPlanes; opIndex++) {
+			for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+				for (int tap = 0; tap < 9; tap++) {
+					narrowWeights[(opIndex * 9 + tap) * nPaddedInputPlanes
+							+ ipIndex] = flatWeights[(opIndex * nInputPlanes
+							+ ipIndex) * 9 + tap];
+				}
+			}
+		}
+	}
+
+}
+
+}
@@ -0,0 +1,79 @@
+/*
+ * packedWeights.hpp
+ *   3x3 weights of a layer in one contiguous, SIMD-aligned buffer
+ *
+ *   Output planes are interleaved in blocks of weightBlockSize (SIMD width):
+ *     weight(ob, ipIndex, tap, lane) is at
+ *       ((ob * nPaddedInputPlanes + ipIndex) * 9 + tap) * weightBlockSize + lane
+ *   for output plane (ob * weightBlockSize + lane), so that a kernel computing
+ *   one block of output planes reads its weights linearly.
+ *   Input planes are padded to a multiple of weightBlockSize too (same as
+ *   channel blocks of ActivationTensor).
+ *   Planes in the padding have zero weight and bias.
+ *
+ *   Layers with less output planes than a block (like 128->1) also keep
+ *   weights of each output plane as 9 x nPaddedInputPlanes (tap-major), for
+ *   kernels vectorized over input planes instead of output planes.
+ */
+
+#ifndef PACKED_WEIGHTS_HPP_
+#define PACKED_WEIGHTS_HPP_
+
+#include "alignedBuffer.hpp"
+#include <vector>
+
+namespace w2xc {
+
+// number of output planes interleaved in a block
+constexpr int weightBlockSize = 8;
+
+class PackedWeights {
+
+private:
+	int nPaddedInputPlanes;
+	int nBlocks;
+	AlignedBuffer<float> weights;
+	AlignedBuffer<float> biases; // padded to nBlocks * weightBlockSize
+	AlignedBuffer<float> narrowWeights; // empty unless narrow layer
+
+public:
+	PackedWeights() :
+			nPaddedInputPlanes(0), nBlocks(0) {
+	}
+
+	/**
+	 * flatWeights : nOutputPlanes x nInputPlanes x 9 (row-major 3x3)
+	 */
+	void pack(const float *flatWeights, const std::vector<double> &biasValues,
+			int nInputPlanes, int nOutputPlanes);
+
+	int getNumberOfBlocks() const {
+		return nBlocks;
+	}
+	int getNPaddedInputPlanes() const {
+		return nPaddedInputPlanes;
+	}
+	// weights of output plane opIndex as 9 x nPaddedInputPlanes
+	// (only for layers with less than weightBlockSize output planes)
+	const float *getNarrowWeights(int opIndex) const {
+		return narrowWeights.data() + opIndex * 9 * nPaddedInputPlanes;
+	}
+	// weights of output plane block ob
+	// (nPaddedInputPlanes * 9 * weightBlockSize)
+	const float *getBlockWeights(int ob) const {
+		return weights.data() + ob * nPaddedInputPlanes * 9 * weightBlockSize;
+	}
+	// biases of output plane block ob (weightBlockSize)
+	const float *getBlockBiases(int ob) const {
+		return biases.data() + ob * weightBlockSize;
+	}
+	// biases of all output planes
+	const float *getBiases() const {
+		return biases.data();
+	}
+
+};
+
+}
+
+#endif /* PACKED_WEIGHTS_HPP_ */
@@ -0,0 +1,108 @@
+/*
+ * quantization.cpp
+ *   8-bit quantization of 3x3 layers (INT8 execution mode)
+ */
+
+#include "quantization.hpp"
+#include "activationTensor.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace w2xc {
+
+QuantizationParams getQuantizationParams(const ActivationRange &range) {
+	// 0 must be representable exactly (padding and LeakyReLU output)
+	float minValue = std::min(range.min, 0.0f);
+	float maxValue = std::max(range.max, 0.0f);
+
+	QuantizationParams params;
+	params.scale = (maxValue - minValue) / 255.0f;
+	if (!(params.scale > 0.0f)) {
+		params.scale = 1.0f / 255.0f;
+	}
+	params.zeroPoint = std::min(255,
+			std::max(0, static_cast<int>(std::lround(-minValue / params.scale))));
+	return params;
+}
+
+void quantizeRow(const float * const *inputRows, int nInputPlanes, int width,
+		const QuantizationParams &params, uint8_t *outputRow) {
+
+	constexpr int C = tensorChannelBlock;
+	const int pixelBytes = getInt8PixelBytes(nInputPlanes);
+	const float invScale = 1.0f / params.scale;
+
+	for (int x = -1; x <= width; x++) {
+		uint8_t *out = outputRow + x * pixelBytes;
+		for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+			float v = inputRows[ipIndex / C][x * C + ipIndex % C];
+			int q = static_cast<int>(std::lrint(v * invScale))
+					+ params.zeroPoint;
+			out[ipIndex] = static_cast<uint8_t>(std::min(255, std::max(0, q)));
+		}
+		std::fill(out + nInputPlanes, out + pixelBytes,
+				static_cast<uint8_t>(params.zeroPoint));
+	}
+
+}
+
+void QuantizedWeights::quantize(const float *flatWeights,
+		const std::vector<double> &biasValues, int nInputPlanes,
+		int nOutputPlanes, const ActivationRange &inputRange) {
+
+	this->nInputPlanes = nInputPlanes;
+	nGroups = getInt8PixelBytes(nInputPlanes) / int8GroupSize;
+	nBlocks = (nOutputPlanes + weightBlockSize - 1) / weightBlockSize;
+	inputParams = getQuantizationParams(inputRange);
+
+	// zero-cleared : padding planes have zero weights, scale and bias
+	// (so they are written as zero by kernels)
+	weights.resize(nBlocks * nGroups * 9 * weightBlockSize * int8GroupSize);
+	scales.resize(nBlocks * weightBlockSize);
+	offsets.resize(nBlocks * weightBlockSize);
+	biases.resize(nBlocks * weightBlockSize);
+
+	for (int opIndex = 0; opIndex < nOutputPlanes; opIndex++) {
+		int ob = opIndex / weightBlockSize;
+		int lane = opIndex % weightBlockSize;
+		const float *w = flatWeights + opIndex * nInputPlanes * 9;
+
+		// symmetric scale per output plane
+		float maxAbs = 0.0f;
+		for (int i = 0; i < nInputPlanes * 9; i++) {
+			maxAbs = std::max(maxAbs, std::fabs(w[i]));
+		}
+		float weightScale = maxAbs > 0.0f ? maxAbs / int8WeightMax : 1.0f;
+
+		int32_t sum = 0;
+		for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+			int group = ipIndex / int8GroupSize;
+			for (int tap = 0; tap < 9; tap++) {
+				int q = static_cast<int>(std::lround(
+						w[ipIndex * 9 + tap] / weightScale));
+				q = std::min(int8WeightMax, std::max(-int8WeightMax, q));
+				weights[(((ob * nGroups + group) * 9 + tap) * weightBlockSize
+						+ lane) * int8GroupSize + ipIndex % int8GroupSize] =
+						static_cast<int8_t>(q);
+				sum += q;
+			}
+		}
+
+		scales[opIndex] = inputParams.scale * weightScale;
+		offsets[opIndex] = inputParams.zeroPoint * sum;
+		biases[opIndex] = static_cast<float>(biasValues[opIndex]);
+	}
+
+}
+
+void QuantizedWeights::clear() {
+	nInputPlanes = 0;
+	nGroups = 0;
+	nBlocks = 0;
+	weights = AlignedBuffer<int8_t>();
+	scales = AlignedBuffer<float>();
+	offsets = AlignedBuffer<int32_t>();
+	biases = AlignedBuffer<float>();
+}
+
+}
@@ -0,0 +1,136 @@
+/*
+ * quantization.hpp
+ *   8-bit quantization of 3x3 layers (INT8 execution mode)
+ *
+ *   Activations (layer inputs) are quantized per layer as unsigned 8-bit
+ *   with zero point, from ranges calibrated over sample images :
+ *     x = scale * (q - zeroPoint)
+ *   Weights are quantized per output plane as signed 7-bit (-63 .. 63),
+ *   so that a pair of u8 x s8 products never saturates the 16-bit sums of
+ *   pmaddubsw, and all int8 kernels produce the same integer sums.
+ *
+ *   Quantized rows store all input planes of a pixel together, padded to a
+ *   multiple of int8GroupSize (4 planes are multiplied-added at once) :
+ *     q(x, ipIndex) is at row[x * getInt8PixelBytes(nInputPlanes) + ipIndex]
+ *   Pixels -1 and width of a row are written too (halo for 3x3 kernel).
+ *
+ *   Packed weights are interleaved in blocks of weightBlockSize output planes
+ *   (same as PackedWeights) :
+ *     weight(ob, group, tap, lane, i) is at
+ *       (((ob * nGroups + group) * 9 + tap) * weightBlockSize + lane)
+ *       * int8GroupSize + i
+ *   for output plane (ob * weightBlockSize + lane) and input plane
+ *   (group * int8GroupSize + i).
+ *
+ *   Output of a model calibrated over its input differs from float path by
+ *   quantization error (tolerance : 0.03 absolute on output of random
+ *   models of the layer shapes of waifu2x, about 0.013 measured; checked
+ *   by compareKernels.cpp).
+ */
+
+#ifndef QUANTIZATION_HPP_
+#define QUANTIZATION_HPP_
+
+#include "alignedBuffer.hpp"
+#include "packedWeights.hpp"
+#include <vector>
+#include <cstdint>
+
+namespace w2xc {
+
+// number of input planes multiplied-added together (into one int32)
+constexpr int int8GroupSize = 4;
+// range of quantized weights (-int8WeightMax .. int8WeightMax)
+constexpr int int8WeightMax = 63;
+
+// bytes per pixel of a quantized row
+inline int getInt8PixelBytes(int nInputPlanes) {
+	return (nInputPlanes + int8GroupSize - 1) / int8GroupSize * int8GroupSize;
+}
+
+// range of activations observed in calibration
+struct ActivationRange {
+	float min;
+	float max;
+};
+
+struct QuantizationParams {
+	float scale;
+	int zeroPoint;
+};
+
+// u8 quantization covering range (and 0)
+QuantizationParams getQuantizationParams(const ActivationRange &range);
+
+/**
+ * quantize pixels -1 .. width of one row
+ * inputRows  : pixel 0 of the row of each input channel block
+ *              (channel-blocked layout of ActivationTensor, halo readable)
+ * outputRow  : pixel 0 of quantized row (see above)
+ * planes in the padding are written as zero point
+ */
+void quantizeRow(const float * const *inputRows, int nInputPlanes, int width,
+		const QuantizationParams &params, uint8_t *outputRow);
+
+class QuantizedWeights {
+
+private:
+	int nInputPlanes;
+	int nGroups;
+	int nBlocks;
+	QuantizationParams inputParams;
+	AlignedBuffer<int8_t> weights;
+	// per output plane (padded to nBlocks * weightBlockSize)
+	AlignedBuffer<float> scales; // input scale * weight scale
+	AlignedBuffer<int32_t> offsets; // zeroPoint * (sum of quantized weights)
+	AlignedBuffer<float> biases;
+
+public:
+	QuantizedWeights() :
+			nInputPlanes(0), nGroups(0), nBlocks(0), inputParams( { 1.0f, 0 }) {
+	}
+
+	/**
+	 * flatWeights : nOutputPlanes x nInputPlanes x 9 (row-major 3x3)
+	 * inputRange  : calibrated range of layer input
+	 */
+	void quantize(const float *flatWeights,
+			const std::vector<double> &biasValues, int nInputPlanes,
+			int nOutputPlanes, const ActivationRange &inputRange);
+	// back to not quantized
+	void clear();
+
+	bool empty() const {
+		return nBlocks == 0;
+	}
+	int getNInputPlanes() const {
+		return nInputPlanes;
+	}
+	int getNumberOfBlocks() const {
+		return nBlocks;
+	}
+	const QuantizationParams &getInputParams() const {
+		return inputParams;
+	}
+	// weights of output plane block ob
+	// (nGroups * 9 * weightBlockSize * int8GroupSize)
+	const int8_t *getBlockWeights(int ob) const {
+		return weights.data()
+				+ ob * nGroups * 9 * weightBlockSize * int8GroupSize;
+	}
+	// per output plane values of block ob (weightBlockSize each)
+	const float *getBlockScales(int ob) const {
+		return scales.data() + ob * weightBlockSize;
+	}
+	const int32_t *getBlockOffsets(int ob) const {
+		return offsets.data() + ob * weightBlockSize;
+	}
+	const float *getBlockBiases(int ob) const {
+		return biases.data() + ob * weightBlockSize;
+	}
+
+};
+
+}
+
+#endif /* QUANTIZATION_HPP_ */
@@ -51,13 +51,9 @@ int main(int argc, char** argv) {
 	cv::split(imageYUV, imageSprit);
 	*/
 
-	std::unique_ptr<std::vector<cv::Mat> > inputPlanes = std::unique_ptr<
-			std::vector<cv::Mat> >(new std::vector<cv::Mat>(1));
-	std::unique_ptr<std::vector<cv::Mat> > outputPlanes = std::unique_ptr<
-			std::vector<cv::Mat> >(new std::vector<cv::Mat>(32));
-
-	inputPlanes->clear();
-	inputPlanes->push_back(imageY);
+	w2xc::ActivationTensor inputPlanes = w2xc::ActivationTensor::fromPlane(
+			imageY);
+	w2xc::ActivationTensor outputPlanes;
 
 	/*
 	cv::Mat test;
@@ -73,18 +69,16 @@ int main(int argc, char** argv) {
 		std::cout << "Iteration #" << (index + 1) << "..." << std::endl;
 //		std::cout << models[index]->getNInputPlanes() << ","
 //				<< models[index]->getNOutputPlanes() << std::endl;
-		if(!models[index]->filter(*inputPlanes, *outputPlanes)){
+		if(!models[index]->filter(inputPlanes, outputPlanes)){
 			std::exit(-1);
 		}
-		std::cout << outputPlanes->size() << std::endl;
+		std::cout << outputPlanes.getNChannels() << std::endl;
 		if (index != models.size() - 1) {
-			inputPlanes = std::move(outputPlanes);
-			outputPlanes = std::unique_ptr<std::vector<cv::Mat> >(
-					new std::vector<cv::Mat>(models[index + 1]->getNOutputPlanes()));
+			inputPlanes = outputPlanes;
 		}
 	}
 
-	outputPlanes->at(0).copyTo(imageSprit[0]);
+	outputPlanes.toPlane(0, imageSprit[0]);
 	cv::Mat result;
 	cv::merge(imageSprit,result);
 	cv::cvtColor(result,result,COLOR_YUV2RGB);
@@ -0,0 +1,133 @@
+/*
+ * threadPool.cpp
+ *   pool of long-lived worker threads shared by Model::filter and
+ *   block processing in convertRoutine
+ */
+
+#include "threadPool.hpp"
+#include <algorithm>
+
+namespace w2xc {
+
+// one parallelFor() call (lives on the stack of calling thread)
+struct ThreadPool::Job {
+	const std::function<void(int)> *task;
+	int nTasks;
+	int maxParallel;
+	// below are guarded by ThreadPool::mtx
+	int nextTask;
+	int nRunning;
+	int nFinished;
+};
+
+ThreadPool::ThreadPool(int nThreads) :
+		stopping(false) {
+	// calling thread of parallelFor() also runs tasks
+	for (int i = 0; i < nThreads - 1; i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		stopping = true;
+	}
+	workCv.notify_all();
+	for (auto& th : workers) {
+		th.join();
+	}
+}
+
+int ThreadPool::getNumberOfThreads() {
+	return static_cast<int>(workers.size()) + 1;
+}
+
+ThreadPool::Job *ThreadPool::findClaimableJob() {
+	for (auto&& job : jobs) {
+		if (job->nRunning < job->maxParallel) {
+			return job;
+		}
+	}
+	return nullptr;
+}
+
+int ThreadPool::claimTask(Job *job) {
+	int index = job->nextTask++;
+	job->nRunning++;
+	if (job->nextTask == job->nTasks) {
+		// all tasks issued, nobody needs to find this job any more
+		jobs.erase(std::find(jobs.begin(), jobs.end(), job));
+	}
+	return index;
+}
+
+void ThreadPool::finishTask(Job *job) {
+	job->nRunning--;
+	job->nFinished++;
+	if (job->nFinished == job->nTasks) {
+		// job may be destroyed by its owner right after this
+		doneCv.notify_all();
+	} else if (job->maxParallel < job->nTasks
+			&& job->nextTask < job->nTasks) {
+		// a slot of limited job is free now
+		workCv.notify_all();
+		doneCv.notify_all();
+	}
+}
+
+void ThreadPool::workerLoop() {
+	std::unique_lock<std::mutex> lock(mtx);
+
+	while (true) {
+		Job *job = nullptr;
+		workCv.wait(lock, [&]() {
+			return stopping || (job = findClaimableJob()) != nullptr;
+		});
+		if (job == nullptr) {
+			return; // stopping
+		}
+
+		int index = claimTask(job);
+		lock.unlock();
+		(*job->task)(index);
+		lock.lock();
+		finishTask(job);
+	}
+}
+
+void ThreadPool::parallelFor(int nTasks, const std::function<void(int)> &task,
+		int maxParallel) {
+
+	if (nTasks <= 0)
+		return;
+
+	Job job;
+	job.task = &task;
+	job.nTasks = nTasks;
+	job.maxParallel = (maxParallel > 0) ? maxParallel : nTasks;
+	job.nextTask = 0;
+	job.nRunning = 0;
+	job.nFinished = 0;
+
+	std::unique_lock<std::mutex> lock(mtx);
+	jobs.push_back(&job);
+	workCv.notify_all();
+
+	// calling thread works on its own job too, and waits for the rest
+	// (completion barrier)
+	while (job.nFinished < job.nTasks) {
+		if (job.nextTask < job.nTasks && job.nRunning < job.maxParallel) {
+			int index = claimTask(&job);
+			lock.unlock();
+			task(index);
+			lock.lock();
+			finishTask(&job);
+		} else {
+			doneCv.wait(lock);
+		}
+	}
+
+}
+
+}
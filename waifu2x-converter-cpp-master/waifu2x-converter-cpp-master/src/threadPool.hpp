@@ -0,0 +1,66 @@
+/*
+ * threadPool.hpp
+ *   pool of long-lived worker threads shared by Model::filter and
+ *   block processing in convertRoutine
+ */
+
+#ifndef THREAD_POOL_HPP_
+#define THREAD_POOL_HPP_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace w2xc {
+
+class ThreadPool {
+
+private:
+	struct Job;
+
+	std::vector<std::thread> workers;
+	std::deque<Job *> jobs; // jobs which still have unissued tasks
+	std::mutex mtx;
+	std::condition_variable workCv; // new task can be claimed
+	std::condition_variable doneCv; // some job has finished or freed a slot
+	bool stopping;
+
+	ThreadPool() = delete;
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+
+	// worker thread function
+	void workerLoop();
+
+	// these must be called with mtx locked
+	Job *findClaimableJob();
+	int claimTask(Job *job);
+	void finishTask(Job *job);
+
+public:
+	// nThreads : number of threads running tasks at the same time
+	//            (calling thread of parallelFor() is one of them)
+	explicit ThreadPool(int nThreads);
+	~ThreadPool();
+
+	int getNumberOfThreads();
+
+	/**
+	 * run task(0) ... task(nTasks - 1) on pooled threads and calling thread,
+	 * and return when all of them have finished.
+	 * tasks are issued dynamically (next free thread takes next index).
+	 * maxParallel limits the number of tasks of this call running at once
+	 * (0 means no limit).
+	 * parallelFor() may be called from inside a task (nested call).
+	 */
+	void parallelFor(int nTasks, const std::function<void(int)> &task,
+			int maxParallel = 0);
+
+};
+
+}
+
+#endif /* THREAD_POOL_HPP_ */
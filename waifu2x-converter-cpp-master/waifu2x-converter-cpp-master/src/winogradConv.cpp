@@ -0,0 +1,159 @@
+/*
+ * winogradConv.cpp
+ *   Winograd F(4x4, 3x3) convolution engine
+ */
+
+#include "winogradConv.hpp"
+#include "filterKernels.hpp"
+#include <algorithm>
+
+namespace w2xc {
+
+// out = G * in (3 -> 6)
+static inline void transformWeight1D(const float *in, int inStep, float *out,
+		int outStep) {
+	const float g0 = in[0], g1 = in[inStep], g2 = in[2 * inStep];
+	out[0 * outStep] = g0 / 4.0f;
+	out[1 * outStep] = -(g0 + g1 + g2) / 6.0f;
+	out[2 * outStep] = -(g0 - g1 + g2) / 6.0f;
+	out[3 * outStep] = g0 / 24.0f + g1 / 12.0f + g2 / 6.0f;
+	out[4 * outStep] = g0 / 24.0f - g1 / 12.0f + g2 / 6.0f;
+	out[5 * outStep] = g2;
+}
+
+// out = B^T * in (6 -> 6)
+static inline void transformInput1D(const float *in, int inStep, float *out,
+		int outStep) {
+	const float d0 = in[0 * inStep], d1 = in[1 * inStep], d2 = in[2 * inStep];
+	const float d3 = in[3 * inStep], d4 = in[4 * inStep], d5 = in[5 * inStep];
+	out[0 * outStep] = 4.0f * d0 - 5.0f * d2 + d4;
+	out[1 * outStep] = -4.0f * d1 - 4.0f * d2 + d3 + d4;
+	out[2 * outStep] = 4.0f * d1 - 4.0f * d2 - d3 + d4;
+	out[3 * outStep] = -2.0f * d1 - d2 + 2.0f * d3 + d4;
+	out[4 * outStep] = 2.0f * d1 - d2 - 2.0f * d3 + d4;
+	out[5 * outStep] = 4.0f * d1 - 5.0f * d3 + d5;
+}
+
+// out = A^T * in (6 -> 4)
+static inline void transformOutput1D(const float *in, int inStep, float *out,
+		int outStep) {
+	const float m0 = in[0 * inStep], m1 = in[1 * inStep], m2 = in[2 * inStep];
+	const float m3 = in[3 * inStep], m4 = in[4 * inStep], m5 = in[5 * inStep];
+	out[0 * outStep] = m0 + m1 + m2 + m3 + m4;
+	out[1 * outStep] = m1 - m2 + 2.0f * m3 - 2.0f * m4;
+	out[2 * outStep] = m1 + m2 + 4.0f * m3 + 4.0f * m4;
+	out[3 * outStep] = m1 - m2 + 8.0f * m3 - 8.0f * m4 + m5;
+}
+
+void winogradTransformWeights(const float *weights, int nInputPlanes,
+		int nOutputPlanes, float *transformed) {
+
+	for (int opIndex = 0; opIndex < nOutputPlanes; opIndex++) {
+		for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+			const float *g = weights + (opIndex * nInputPlanes + ipIndex) * 9;
+			float tmp[6 * 3];
+			float u[winogradElements];
+
+			// tmp = G g (each column), u = tmp G^T (each row)
+			for (int c = 0; c < 3; c++) {
+				transformWeight1D(g + c, 3, tmp + c, 3);
+			}
+			for (int r = 0; r < 6; r++) {
+				transformWeight1D(tmp + r * 3, 1, u + r * 6, 1);
+			}
+
+			for (int e = 0; e < winogradElements; e++) {
+				transformed[(e * nOutputPlanes + opIndex) * nInputPlanes
+						+ ipIndex] = u[e];
+			}
+		}
+	}
+
+}
+
+void winogradInputTransformRow(const float * const *inputRows,
+		int nInputPlanes, int width, int pixelStride, float *V, int ldV) {
+
+	int nTiles = (width + winogradTileSize - 1) / winogradTileSize;
+
+	for (int ipIndex = 0; ipIndex < nInputPlanes; ipIndex++) {
+		const float * const *rows = inputRows + ipIndex * 6;
+
+		for (int tile = 0; tile < nTiles; tile++) {
+			int x0 = tile * winogradTileSize - 1;
+			float d[winogradElements];
+			float tmp[winogradElements];
+			float v[winogradElements];
+
+			// gather 6x6 input tile with replicated borders
+			if (x0 >= 0 && x0 + 6 <= width) {
+				for (int r = 0; r < 6; r++) {
+					for (int c = 0; c < 6; c++) {
+						d[r * 6 + c] = rows[r][(x0 + c) * pixelStride];
+					}
+				}
+			} else {
+				for (int r = 0; r < 6; r++) {
+					for (int c = 0; c < 6; c++) {
+						int x = std::min(std::max(x0 + c, 0), width - 1);
+						d[r * 6 + c] = rows[r][x * pixelStride];
+					}
+				}
+			}
+
+			// tmp = B^T d (each column), v = tmp B (each row)
+			for (int c = 0; c < 6; c++) {
+				transformInput1D(d + c, 6, tmp + c, 6);
+			}
+			for (int r = 0; r < 6; r++) {
+				transformInput1D(tmp + r * 6, 1, v + r * 6, 1);
+			}
+
+			for (int e = 0; e < winogradElements; e++) {
+				V[(e * nInputPlanes + ipIndex) * ldV + tile] = v[e];
+			}
+		} // for tile
+
+	} // for ipIndex
+
+}
+
+void winogradOutputTransformRow(const float *M, int ldM, int nOutputPlanes,
+		const float *biases, float * const *outputRows, int nRows, int width,
+		int pixelStride) {
+
+	int nTiles = (width + winogradTileSize - 1) / winogradTileSize;
+
+	for (int opIndex = 0; opIndex < nOutputPlanes; opIndex++) {
+		float * const *rows = outputRows + opIndex * 4;
+
+		for (int tile = 0; tile < nTiles; tile++) {
+			int x0 = tile * winogradTileSize;
+			int nCols = std::min(winogradTileSize, width - x0);
+			float m[winogradElements];
+			float tmp[4 * 6];
+			float y[4 * 4];
+
+			for (int e = 0; e < winogradElements; e++) {
+				m[e] = M[(e * nOutputPlanes + opIndex) * ldM + tile];
+			}
+
+			// tmp = A^T m (each column), y = tmp A (each row)
+			for (int c = 0; c < 6; c++) {
+				transformOutput1D(m + c, 6, tmp + c, 6);
+			}
+			for (int r = 0; r < 4; r++) {
+				transformOutput1D(tmp + r * 6, 1, y + r * 4, 1);
+			}
+
+			for (int r = 0; r < nRows; r++) {
+				biasLeakyReLU(y + r * 4, biases[opIndex],
+						rows[r] + x0 * pixelStride, nCols, pixelStride);
+			}
+		} // for tile
+
+	} // for opIndex
+
+}
+
+}
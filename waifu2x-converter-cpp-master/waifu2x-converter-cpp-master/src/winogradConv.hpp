@@ -0,0 +1,61 @@
+/*
+ * winogradConv.hpp
+ *   Winograd F(4x4, 3x3) convolution engine
+ *
+ *   Each 4x4 output tile is computed from a 6x6 input tile as
+ *     Y = A^T [ sum_ip (G g G^T) .* (B^T d B) ] A
+ *   The element-wise products over input planes are done as 36 matrix
+ *   multiplies (one per element of the 6x6 transformed tile).
+ *
+ *   Winograd trades multiplies for additions, so results differ from the
+ *   direct kernel by rounding (about 1e-5 relative on the shipped models).
+ */
+
+#ifndef WINOGRAD_CONV_HPP_
+#define WINOGRAD_CONV_HPP_
+
+namespace w2xc {
+
+// size of output tile, and of transformed (input) tile
+constexpr int winogradTileSize = 4;
+constexpr int winogradInputTileSize = 6;
+constexpr int winogradElements = 36;
+
+/**
+ * transform 3x3 weights into Winograd domain (done once at model loading).
+ *
+ * weights     : nOutputPlanes x nInputPlanes x 9 (row-major 3x3)
+ * transformed : 36 x nOutputPlanes x nInputPlanes
+ */
+void winogradTransformWeights(const float *weights, int nInputPlanes,
+		int nOutputPlanes, float *transformed);
+
+/**
+ * transform one row of input tiles (6 input rows make 4 output rows).
+ *
+ * inputRows   : 6 row pointers per input plane, inputRows[ipIndex * 6 + 0..5]
+ *               (rows outside of the plane should point replicated rows)
+ * pixelStride : distance between pixels of a row (in floats)
+ * V           : transformed tiles, V[(e * nInputPlanes + ipIndex) * ldV + tile]
+ *               (tile 0 of this row is at V[0])
+ *
+ * columns outside of the row are replicated (same as cv::BORDER_REPLICATE).
+ */
+void winogradInputTransformRow(const float * const *inputRows,
+		int nInputPlanes, int width, int pixelStride, float *V, int ldV);
+
+/**
+ * inverse transform one row of output tiles, add bias and apply LeakyReLU(0.1).
+ *
+ * M           : products, M[(e * nOutputPlanes + opIndex) * ldM + tile]
+ * outputRows  : 4 row pointers per output plane, outputRows[opIndex * 4 + 0..3]
+ * nRows       : number of valid rows in this tile row (1 to 4)
+ * pixelStride : distance between pixels of output rows (in floats)
+ */
+void winogradOutputTransformRow(const float *M, int ldM, int nOutputPlanes,
+		const float *biases, float * const *outputRows, int nRows, int width,
+		int pixelStride);
+
+}
+
+#endif /* WINOGRAD_CONV_HPP_ */